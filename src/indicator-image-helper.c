@@ -23,6 +23,7 @@ License along with this library. If not, see
 
 #include <math.h>
 #include "indicator-image-helper.h"
+#include "indicator-trace.h"
 
 const gchar * INDICATOR_NAMES_DATA = "indicator-names-data";
 const gint ICON_SIZE = 22;
@@ -33,6 +34,7 @@ refresh_image (GtkImage * image)
 	g_return_if_fail(GTK_IS_IMAGE(image));
 	const gchar * icon_filename = NULL;
 	GtkIconInfo * icon_info = NULL;
+	INDICATOR_TRACE_SCOPE("refresh-image", INDICATOR_TRACE_GET_NAME(image));
 
 	GIcon * icon_names = (GIcon *)g_object_get_data(G_OBJECT(image), INDICATOR_NAMES_DATA);
 	g_return_if_fail(G_IS_ICON (icon_names));
@@ -0,0 +1,494 @@
+/*
+ * Copyright 2026 Ayatana Indicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "indicator-ng-index.h"
+#include <gio/gio.h>
+#include <string.h>
+
+/*
+ * The cache is a header, followed by the records and a table of
+ * nul-terminated strings the records point into by offset:
+ *
+ *   IndexHeader
+ *   IndexRecord[n_records]
+ *   gchar strings[strings_size]
+ *
+ * It is only ever read on the machine that wrote it, so everything is
+ * stored in host byte order. The byte order marker makes a cache in a
+ * home directory shared between architectures count as out of date.
+ */
+
+#define INDEX_MAGIC "AYIDXNG"
+#define INDEX_VERSION 2
+#define INDEX_BYTE_ORDER 0x01020304
+
+typedef struct
+{
+  gchar   magic[8];
+  guint32 version;
+  guint32 byte_order;
+  gint64  dir_mtime;
+  guint32 n_records;
+  guint32 service_dir;
+  guint32 strings_size;
+  guint32 padding;
+} IndexHeader;
+
+typedef struct
+{
+  guint32 service_file;
+  guint32 name;
+  guint32 object_path;
+  guint32 profile;
+  guint32 menu_object_path;
+  gint32  position;
+  guint32 max_update_rate;
+  guint32 padding;
+} IndexRecord;
+
+struct _IndicatorNgIndex
+{
+  GBytes *data;
+  IndicatorNgIndexRecord *records;
+  guint n_records;
+  gboolean cached;
+};
+
+typedef struct
+{
+  GArray *records;
+  GByteArray *strings;
+  GHashTable *offsets;
+} IndexBuilder;
+
+static gint
+index_key_file_maybe_get_integer (GKeyFile    *keyfile,
+                                  const gchar *group,
+                                  const gchar *key,
+                                  gint         default_value)
+{
+  GError *error = NULL;
+  gint value;
+
+  value = g_key_file_get_integer (keyfile, group, key, &error);
+  if (error)
+    {
+      g_error_free (error);
+      return default_value;
+    }
+
+  return value;
+}
+
+static gint64
+index_get_dir_mtime (const gchar  *service_dir,
+                     GError      **error)
+{
+  GFile *dir;
+  GFileInfo *info;
+  gint64 mtime = -1;
+
+  dir = g_file_new_for_path (service_dir);
+  info = g_file_query_info (dir, G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE, NULL, error);
+  if (info)
+    {
+      mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+              g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+      g_object_unref (info);
+    }
+
+  g_object_unref (dir);
+  return mtime;
+}
+
+static guint32
+index_builder_add_string (IndexBuilder *builder,
+                          const gchar  *str)
+{
+  gpointer offset;
+
+  if (g_hash_table_lookup_extended (builder->offsets, str, NULL, &offset))
+    return GPOINTER_TO_UINT (offset);
+
+  offset = GUINT_TO_POINTER (builder->strings->len);
+  g_byte_array_append (builder->strings, (const guint8 *) str, strlen (str) + 1);
+  g_hash_table_insert (builder->offsets, g_strdup (str), offset);
+
+  return GPOINTER_TO_UINT (offset);
+}
+
+/* Adds a record for every profile of @service_file. Files that
+ * indicator_ng_new() would refuse are skipped. */
+static void
+index_builder_add_service_file (IndexBuilder *builder,
+                                const gchar  *service_file)
+{
+  GKeyFile *keyfile;
+  gchar *name = NULL;
+  gchar *object_path = NULL;
+  gchar **groups = NULL;
+  gint position;
+  gint max_update_rate;
+
+  keyfile = g_key_file_new ();
+  if (!g_key_file_load_from_file (keyfile, service_file, G_KEY_FILE_NONE, NULL))
+    goto out;
+
+  name = g_key_file_get_string (keyfile, "Indicator Service", "Name", NULL);
+  object_path = g_key_file_get_string (keyfile, "Indicator Service", "ObjectPath", NULL);
+  if (name == NULL || object_path == NULL)
+    goto out;
+
+  position = index_key_file_maybe_get_integer (keyfile, "Indicator Service", "Position", -1);
+  max_update_rate = MAX (index_key_file_maybe_get_integer (keyfile, "Indicator Service", "MaxUpdateRate", 0), 0);
+
+  groups = g_key_file_get_groups (keyfile, NULL);
+  for (gint i = 0; groups[i]; i++)
+    {
+      IndexRecord record;
+      gchar *menu_object_path;
+
+      if (g_str_equal (groups[i], "Indicator Service"))
+        continue;
+
+      menu_object_path = g_key_file_get_string (keyfile, groups[i], "ObjectPath", NULL);
+      if (menu_object_path == NULL)
+        continue;
+
+      record.service_file = index_builder_add_string (builder, service_file);
+      record.name = index_builder_add_string (builder, name);
+      record.object_path = index_builder_add_string (builder, object_path);
+      record.profile = index_builder_add_string (builder, groups[i]);
+      record.menu_object_path = index_builder_add_string (builder, menu_object_path);
+      record.position = index_key_file_maybe_get_integer (keyfile, groups[i], "Position", position);
+      record.max_update_rate = max_update_rate;
+      record.padding = 0;
+      g_array_append_val (builder->records, record);
+
+      g_free (menu_object_path);
+    }
+
+out:
+  g_strfreev (groups);
+  g_free (object_path);
+  g_free (name);
+  g_key_file_free (keyfile);
+}
+
+static gint
+index_compare_names (gconstpointer a,
+                     gconstpointer b)
+{
+  return g_strcmp0 (*(const gchar **) a, *(const gchar **) b);
+}
+
+/* Reads every service file in @service_dir and serializes the result */
+static GBytes *
+index_build (const gchar  *service_dir,
+             gint64        dir_mtime,
+             GError      **error)
+{
+  IndexBuilder builder;
+  IndexHeader header = { INDEX_MAGIC, INDEX_VERSION, INDEX_BYTE_ORDER, dir_mtime, 0, 0, 0, 0 };
+  GPtrArray *names;
+  GByteArray *data;
+  const gchar *name;
+  GDir *dir;
+
+  dir = g_dir_open (service_dir, 0, error);
+  if (dir == NULL)
+    return NULL;
+
+  /* sorted, so that the records have a stable order */
+  names = g_ptr_array_new_with_free_func (g_free);
+  while ((name = g_dir_read_name (dir)))
+    if (name[0] != '.')
+      g_ptr_array_add (names, g_strdup (name));
+  g_ptr_array_sort (names, index_compare_names);
+  g_dir_close (dir);
+
+  builder.records = g_array_new (FALSE, FALSE, sizeof (IndexRecord));
+  builder.strings = g_byte_array_new ();
+  builder.offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  header.service_dir = index_builder_add_string (&builder, service_dir);
+
+  for (guint i = 0; i < names->len; i++)
+    {
+      gchar *service_file = g_build_filename (service_dir, g_ptr_array_index (names, i), NULL);
+
+      if (g_file_test (service_file, G_FILE_TEST_IS_REGULAR))
+        index_builder_add_service_file (&builder, service_file);
+
+      g_free (service_file);
+    }
+
+  header.n_records = builder.records->len;
+  header.strings_size = builder.strings->len;
+
+  data = g_byte_array_sized_new (sizeof header + builder.records->len * sizeof (IndexRecord) + builder.strings->len);
+  g_byte_array_append (data, (const guint8 *) &header, sizeof header);
+  g_byte_array_append (data, (const guint8 *) builder.records->data, builder.records->len * sizeof (IndexRecord));
+  g_byte_array_append (data, builder.strings->data, builder.strings->len);
+
+  g_hash_table_destroy (builder.offsets);
+  g_byte_array_unref (builder.strings);
+  g_array_unref (builder.records);
+  g_ptr_array_unref (names);
+
+  return g_byte_array_free_to_bytes (data);
+}
+
+/* Checks @data against @service_dir and @dir_mtime and fills in the
+ * records of @index. Returns FALSE if @data is out of date or broken. */
+static gboolean
+index_load (IndicatorNgIndex *index,
+            GBytes           *data,
+            const gchar      *service_dir,
+            gint64            dir_mtime)
+{
+  const IndexHeader *header;
+  const IndexRecord *records;
+  const gchar *strings;
+  gsize size;
+
+  header = g_bytes_get_data (data, &size);
+
+  if (size < sizeof (IndexHeader) ||
+      memcmp (header->magic, INDEX_MAGIC, sizeof header->magic) != 0 ||
+      header->version != INDEX_VERSION ||
+      header->byte_order != INDEX_BYTE_ORDER ||
+      header->dir_mtime != dir_mtime)
+    return FALSE;
+
+  if ((size - sizeof (IndexHeader)) / sizeof (IndexRecord) < header->n_records ||
+      size - sizeof (IndexHeader) - header->n_records * sizeof (IndexRecord) != header->strings_size ||
+      header->strings_size == 0)
+    return FALSE;
+
+  records = (const IndexRecord *) (header + 1);
+  strings = (const gchar *) (records + header->n_records);
+
+  /* every string ends before the end of the table */
+  if (strings[header->strings_size - 1] != '\0' ||
+      header->service_dir >= header->strings_size ||
+      !g_str_equal (strings + header->service_dir, service_dir))
+    return FALSE;
+
+  index->records = g_new (IndicatorNgIndexRecord, header->n_records);
+
+  for (guint i = 0; i < header->n_records; i++)
+    {
+      const IndexRecord *record = &records[i];
+
+      if (record->service_file >= header->strings_size ||
+          record->name >= header->strings_size ||
+          record->object_path >= header->strings_size ||
+          record->profile >= header->strings_size ||
+          record->menu_object_path >= header->strings_size)
+        {
+          g_clear_pointer (&index->records, g_free);
+          return FALSE;
+        }
+
+      index->records[i].service_file = strings + record->service_file;
+      index->records[i].name = strings + record->name;
+      index->records[i].object_path = strings + record->object_path;
+      index->records[i].profile = strings + record->profile;
+      index->records[i].menu_object_path = strings + record->menu_object_path;
+      index->records[i].position = record->position;
+      index->records[i].max_update_rate = record->max_update_rate;
+    }
+
+  index->n_records = header->n_records;
+  index->data = g_bytes_ref (data);
+
+  return TRUE;
+}
+
+/**
+ * indicator_ng_index_new:
+ * @service_dir: the directory holding the indicator service files
+ * @cache_file: (allow-none): where to keep the index, or %NULL for the
+ *   default location in the user's cache directory
+ * @error: return location for a #GError
+ *
+ * Returns the index of every profile in every service file in
+ * @service_dir. When @cache_file is up to date with the modification
+ * time of @service_dir, it is mapped into memory and no service file is
+ * read at all. Otherwise the directory is scanned and the cache is
+ * written again. Failing to write it is not an error.
+ *
+ * As only the modification time of the directory is compared, service
+ * files must be replaced (as package managers do) rather than edited in
+ * place for the change to be noticed.
+ *
+ * Returns: a new #IndicatorNgIndex, or %NULL if @service_dir can't be read
+ */
+IndicatorNgIndex *
+indicator_ng_index_new (const gchar  *service_dir,
+                        const gchar  *cache_file,
+                        GError      **error)
+{
+  IndicatorNgIndex *index;
+  GMappedFile *mapped;
+  gchar *default_cache_file = NULL;
+  GBytes *data;
+  gint64 dir_mtime;
+
+  g_return_val_if_fail (service_dir != NULL, NULL);
+
+  dir_mtime = index_get_dir_mtime (service_dir, error);
+  if (dir_mtime < 0)
+    return NULL;
+
+  if (cache_file == NULL)
+    {
+      gchar *checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, service_dir, -1);
+      gchar *basename = g_strconcat (checksum, ".index", NULL);
+
+      cache_file = default_cache_file = g_build_filename (g_get_user_cache_dir (), "libayatana-indicator", basename, NULL);
+
+      g_free (basename);
+      g_free (checksum);
+    }
+
+  index = g_slice_new0 (IndicatorNgIndex);
+
+  mapped = g_mapped_file_new (cache_file, FALSE, NULL);
+  if (mapped)
+    {
+      data = g_mapped_file_get_bytes (mapped);
+      index->cached = index_load (index, data, service_dir, dir_mtime);
+      g_bytes_unref (data);
+      g_mapped_file_unref (mapped);
+    }
+
+  if (!index->cached)
+    {
+      data = index_build (service_dir, dir_mtime, error);
+      if (data == NULL || !index_load (index, data, service_dir, dir_mtime))
+        {
+          if (data)
+            g_bytes_unref (data);
+          g_slice_free (IndicatorNgIndex, index);
+          g_free (default_cache_file);
+          return NULL;
+        }
+
+      {
+        GError *write_error = NULL;
+        gchar *cache_dir = g_path_get_dirname (cache_file);
+
+        g_mkdir_with_parents (cache_dir, 0700);
+        if (!g_file_set_contents (cache_file, g_bytes_get_data (data, NULL), g_bytes_get_size (data), &write_error))
+          {
+            g_debug ("unable to write indicator index '%s': %s", cache_file, write_error->message);
+            g_error_free (write_error);
+          }
+
+        g_free (cache_dir);
+      }
+
+      g_bytes_unref (data);
+    }
+
+  g_free (default_cache_file);
+  return index;
+}
+
+void
+indicator_ng_index_free (IndicatorNgIndex *index)
+{
+  if (index == NULL)
+    return;
+
+  g_free (index->records);
+  g_bytes_unref (index->data);
+  g_slice_free (IndicatorNgIndex, index);
+}
+
+/**
+ * indicator_ng_index_is_cached:
+ * @index: an #IndicatorNgIndex
+ *
+ * Returns: %TRUE if @index was read from an up-to-date cache, %FALSE if
+ * the service directory had to be scanned
+ */
+gboolean
+indicator_ng_index_is_cached (IndicatorNgIndex *index)
+{
+  g_return_val_if_fail (index != NULL, FALSE);
+
+  return index->cached;
+}
+
+guint
+indicator_ng_index_get_n_records (IndicatorNgIndex *index)
+{
+  g_return_val_if_fail (index != NULL, 0);
+
+  return index->n_records;
+}
+
+/**
+ * indicator_ng_index_get_record:
+ * @index: an #IndicatorNgIndex
+ * @n: the number of the record
+ *
+ * Returns: (transfer none): the @n-th record of @index. Records are
+ * sorted by service file.
+ */
+const IndicatorNgIndexRecord *
+indicator_ng_index_get_record (IndicatorNgIndex *index,
+                               guint             n)
+{
+  g_return_val_if_fail (index != NULL, NULL);
+  g_return_val_if_fail (n < index->n_records, NULL);
+
+  return &index->records[n];
+}
+
+/**
+ * indicator_ng_index_lookup:
+ * @index: an #IndicatorNgIndex
+ * @service_name: the base name of a service file
+ * @profile: a profile
+ *
+ * Returns: (transfer none): the record of @profile in the service file
+ * named @service_name, or %NULL if there is no such profile
+ */
+const IndicatorNgIndexRecord *
+indicator_ng_index_lookup (IndicatorNgIndex *index,
+                           const gchar      *service_name,
+                           const gchar      *profile)
+{
+  g_return_val_if_fail (index != NULL, NULL);
+  g_return_val_if_fail (service_name != NULL && profile != NULL, NULL);
+
+  for (guint i = 0; i < index->n_records; i++)
+    {
+      const IndicatorNgIndexRecord *record = &index->records[i];
+      const gchar *basename = strrchr (record->service_file, G_DIR_SEPARATOR);
+
+      basename = basename ? basename + 1 : record->service_file;
+      if (g_str_equal (basename, service_name) && g_str_equal (record->profile, profile))
+        return record;
+    }
+
+  return NULL;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2026 Ayatana Indicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_NG_INDEX_H__
+#define __INDICATOR_NG_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _IndicatorNgIndex IndicatorNgIndex;
+
+/**
+ * IndicatorNgIndexRecord:
+ * @service_file: path of the service file
+ * @name: the "Name" of the "Indicator Service" group
+ * @object_path: the "ObjectPath" of the "Indicator Service" group
+ * @profile: the profile (group) this record is for
+ * @menu_object_path: the "ObjectPath" of the profile
+ * @position: the position of the profile, or the global one, or -1
+ * @max_update_rate: the "MaxUpdateRate" of the service, or 0
+ *
+ * One profile of an indicator service file, as stored in an
+ * #IndicatorNgIndex. The strings are owned by the index.
+ */
+typedef struct
+{
+  const gchar *service_file;
+  const gchar *name;
+  const gchar *object_path;
+  const gchar *profile;
+  const gchar *menu_object_path;
+  gint         position;
+  guint        max_update_rate;
+} IndicatorNgIndexRecord;
+
+IndicatorNgIndex *             indicator_ng_index_new          (const gchar       *service_dir,
+                                                                const gchar       *cache_file,
+                                                                GError           **error);
+
+void                           indicator_ng_index_free         (IndicatorNgIndex  *index);
+
+gboolean                       indicator_ng_index_is_cached    (IndicatorNgIndex  *index);
+
+guint                          indicator_ng_index_get_n_records (IndicatorNgIndex *index);
+
+const IndicatorNgIndexRecord * indicator_ng_index_get_record   (IndicatorNgIndex  *index,
+                                                                guint              n);
+
+const IndicatorNgIndexRecord * indicator_ng_index_lookup       (IndicatorNgIndex  *index,
+                                                                const gchar       *service_name,
+                                                                const gchar       *profile);
+
+G_END_DECLS
+
+#endif
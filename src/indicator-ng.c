@@ -21,16 +21,147 @@
 
 #include "indicator-ng.h"
 #include "indicator-image-helper.h"
+#include "indicator-trace.h"
 #include <libayatana-ido/ayatanamenuitemfactory.h>
 #include <string.h>
 
-#define MENU_SECTIONS 20
+#define MENU_SECTION_DEPTH 2
+#define MENU_PREWARM_BUDGET 4000 /* µs of work per idle slice */
+
+#define ICON_CACHE_SIZE 32
+
+/* Restarting crashed services */
+#define RESTART_BACKOFF_INITIAL 500     /* ms before the first restart */
+#define RESTART_BACKOFF_MAX     60000   /* ms */
+#define RESTART_BUDGET          5       /* restarts allowed within... */
+#define RESTART_WINDOW          300     /* ...this many seconds */
+#define RESTART_COOLDOWN        600     /* s before trying again once the budget is spent */
+#define RESTART_STABLE          60      /* s of uptime after which a service counts as recovered */
+
+typedef enum
+{
+    RESTART_CLOSED,    /* restarting with backoff */
+    RESTART_OPEN,      /* budget spent, waiting for the cooldown */
+    RESTART_HALF_OPEN  /* trying once more after the cooldown */
+} IndicatorNgRestartState;
+#define LABEL_CLASS_PADDED "indicator-ng-label-padded"
+#define LABEL_CLASS_UNPADDED "indicator-ng-label-unpadded"
+
+typedef struct _IndicatorNgMenuSection IndicatorNgMenuSection;
+
+typedef enum
+{
+    PREWARM_TRACK,
+    PREWARM_SECTIONS,
+    PREWARM_REALIZE,
+    PREWARM_MEASURE
+} IndicatorNgPrewarmStep;
+
+/* A node of the popup's section tree. The root node tracks the popup
+ * model itself, its children the sections and theirs the subsections.
+ * Each node keeps one slot per model item in lChildren (NULL for items
+ * that don't link a tracked section) and the index of the widget
+ * GtkMenuShell created for each item in lPositions. */
+struct _IndicatorNgMenuSection
+{
+    IndicatorNg *pIndicator;
+    IndicatorNgMenuSection *pParent;
+    GMenuModel *pModel;
+    const gchar *sNamespace;
+    guint nDepth;
+    gulong nHandler;
+    GPtrArray *lChildren;
+    GArray *lPositions;
+    GHashTable *pNamespacedActions;
+};
+
+static void indicator_ng_menu_section_free(gpointer pData);
+static void indicator_ng_request_menu (IndicatorNg *self);
+/* A name watch shared by all the indicators of one service on one
+ * connection, so that the service gets a single match rule no matter
+ * how many profiles or panels show it. It also restarts the service
+ * when it crashes, once for all of them. */
+typedef struct
+{
+  gchar *key;
+  gchar *name;
+  guint watch_id;
+  gboolean known;
+  GDBusConnection *connection;
+  gchar *name_owner;
+  GSList *watchers;
+
+  IndicatorNgRestartState restart_state;
+  GArray *restart_times;
+  gint64 service_appeared_time;
+  guint restart_id;
+  guint restart_count;
+  guint restart_backoff;
+  guint restart_backoff_initial;
+  guint restart_cooldown;
+  gint64 last_restart_time;
+  GCancellable *restart_cancellable;
+} IndicatorNgNameWatch;
+
+static void indicator_ng_unwatch_service (IndicatorNg *self);
+static void indicator_ng_prewarm_cancel(IndicatorNg *self);
+static void indicator_ng_prewarm_schedule(IndicatorNg *self);
+
+typedef struct
+{
+    gboolean bValid;
+    guint nGeneration;
+    gint nWidth;
+    gint nHeight;
+    gint nPadding;
+} IndicatorNgItemSize;
+
+/* An icon variant and what it deserializes to. What the icon renders to
+ * depends on the scale factor and style of each image, so every image
+ * renders it itself */
+typedef struct
+{
+    GVariant *pVariant;
+    GIcon *pIcon;
+} IndicatorNgIconCacheEntry;
+
+/* The decoded state of the header action, as last applied to the entry */
+typedef struct
+{
+  gchar *label;
+  GVariant *icon;
+  gchar *accessible_desc;
+  gchar *tooltip;
+  gboolean visible;
+} IndicatorNgHeader;
+
+/* The signal handlers whose main thread time is reported by
+ * indicator_object_get_stats() */
+typedef enum
+{
+  HANDLER_SERVICE_APPEARED,
+  HANDLER_MENU_CHANGED,
+  HANDLER_UPDATE_ENTRY,
+  HANDLER_MENU_SECTION_CHANGED,
+  HANDLER_MENU_SIZE_ALLOCATE,
+  N_HANDLERS
+} IndicatorNgHandler;
+
+static const gchar *m_lHandlerNames[N_HANDLERS] =
+{
+  "service-appeared",
+  "menu-changed",
+  "update-entry",
+  "menu-section-changed",
+  "menu-size-allocate"
+};
 
 struct _IndicatorNg
 {
   IndicatorObject parent;
 
   gchar *service_file;
+  const IndicatorNgIndexRecord *index_record; /* only during construction */
   gchar *name;
   gchar *object_path;
   gchar *menu_object_path;
@@ -41,36 +172,140 @@ struct _IndicatorNg
   gchar *secondary_action;
   gchar *submenu_action;
   gint position;
-  gchar *sTooltip;
-  guint name_watch_id;
+  IndicatorNgNameWatch *name_watch;
+  guint name_watch_replay_id;
   gboolean bMenuShown;
-  GDBusConnection *session_bus;
+  GDBusConnection *connection;
   GActionGroup *actions;
   GMenuModel *menu;
+  GMenuModel *popup;
 
+  gboolean headless;
   IndicatorObjectEntry entry;
   gchar *accessible_desc;
-
-  gint64 last_service_restart;
-    GMenuModel *lMenuSections[MENU_SECTIONS];
-  GtkCssProvider *label_css_provider;
+  GIcon *icon;
+  IndicatorNgHeader header;
+  gboolean header_valid;
+
+    IndicatorNgMenuSection *pMenuSections;
+
+    guint nMenuGeneration;
+    gboolean bMenuMetricsValid;
+    gint nMenuExtraWidth;
+    gint nMenuExtraHeight;
+    gboolean bMenuAllocating;
+
+  gboolean lazy_menu;
+  gboolean menu_requested;
+
+    gboolean bPrewarmMenu;
+    guint nPrewarmId;
+    IndicatorNgPrewarmStep nPrewarmStep;
+    guint nPrewarmIndex;
+
+  gboolean coalesce_updates;
+  guint update_tick_id;
+  GtkWidget *update_tick_widget;
+  guint update_idle_id;
+  guint merged_updates;
+
+  guint max_update_rate;
+  gboolean max_update_rate_set;
+  gint64 last_update_time;
+  guint rate_limit_id;
+  guint dropped_updates;
+
+  gchar *name_owner;
+  gint scroll_delta;
+  guint scroll_tick_id;
+  GtkWidget *scroll_tick_widget;
+  guint scroll_idle_id;
+  guint max_scrolls_in_flight;
+  guint scrolls_in_flight;
+  GCancellable *scroll_cancellable;
+
+  guint header_updates;
+  guint icon_reloads;
+  guint icon_cache_hits;
+  guint menu_rebuilds;
+  guint ido_recreations;
+  gint64 handler_time[N_HANDLERS];
 };
 
+typedef struct
+{
+  IndicatorNg *self;
+  IndicatorNgHandler handler;
+  gint64 begin;
+} IndicatorNgHandlerTimer;
+
+static void
+indicator_ng_handler_timer_end (IndicatorNgHandlerTimer *timer)
+{
+  timer->self->handler_time[timer->handler] += g_get_monotonic_time () - timer->begin;
+}
+
+/* Adds the time from here to the end of the enclosing block to the
+ * handler's total */
+#define INDICATOR_NG_TIME_HANDLER(self, handler) \
+  __attribute__((cleanup (indicator_ng_handler_timer_end))) \
+  IndicatorNgHandlerTimer G_PASTE (indicator_ng_handler_timer_, __LINE__) = { (self), (handler), g_get_monotonic_time () }
+
+static void indicator_ng_constructed (GObject *object);
 static void indicator_ng_initable_iface_init (GInitableIface *initable);
+static void indicator_ng_async_initable_iface_init (GAsyncInitableIface *initable);
 G_DEFINE_TYPE_WITH_CODE (IndicatorNg, indicator_ng, INDICATOR_OBJECT_TYPE,
-                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, indicator_ng_initable_iface_init))
+                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, indicator_ng_initable_iface_init)
+                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE, indicator_ng_async_initable_iface_init))
 
 enum
 {
   PROP_0,
   PROP_SERVICE_FILE,
   PROP_PROFILE,
+  PROP_LAZY_MENU,
+  PROP_PREWARM_MENU,
+  PROP_COALESCE_UPDATES,
+  PROP_MERGED_UPDATES,
+  PROP_RESTART_COUNT,
+  PROP_RECENT_RESTARTS,
+  PROP_RESTART_BACKOFF,
+  PROP_MAX_UPDATE_RATE,
+  PROP_DROPPED_UPDATES,
+  PROP_MAX_SCROLLS_IN_FLIGHT,
+  PROP_HEADLESS,
+  PROP_LABEL,
+  PROP_ICON,
+  PROP_ACCESSIBLE_DESC,
+  PROP_MENU_MODEL,
+  PROP_INDEX_RECORD,
+  PROP_CONNECTION,
   N_PROPERTIES
 };
 
 static GQuark m_pActionMuxer = 0;
+static GtkCssProvider *m_pLabelCssProvider = NULL;
+static GHashTable *m_pIconCache = NULL;
+static GHashTable *m_pIdoFactories = NULL;
+static GHashTable *m_pNameWatches = NULL;
+static GHashTable *m_pSharedProxies = NULL;
+static GQueue m_lIconCacheLru = G_QUEUE_INIT;
+static GQuark m_pItemSize = 0;
+static GdkRectangle m_cWorkarea;
+static gboolean m_bWorkareaValid = FALSE;
+static gboolean m_bWorkareaWatched = FALSE;
+static GdkMonitor *m_pWorkareaMonitor = NULL;
 static GParamSpec *properties[N_PROPERTIES];
 
+static void
+indicator_ng_header_clear (IndicatorNgHeader *header)
+{
+  g_clear_pointer (&header->label, g_free);
+  g_clear_pointer (&header->icon, g_variant_unref);
+  g_clear_pointer (&header->accessible_desc, g_free);
+  g_clear_pointer (&header->tooltip, g_free);
+}
+
 static void
 indicator_ng_get_property (GObject    *object,
                            guint       property_id,
@@ -89,6 +324,70 @@ indicator_ng_get_property (GObject    *object,
       g_value_set_string (value, self->profile);
       break;
 
+    case PROP_LAZY_MENU:
+      g_value_set_boolean (value, self->lazy_menu);
+      break;
+
+    case PROP_PREWARM_MENU:
+      g_value_set_boolean (value, self->bPrewarmMenu);
+      break;
+
+    case PROP_COALESCE_UPDATES:
+      g_value_set_boolean (value, self->coalesce_updates);
+      break;
+
+    case PROP_MERGED_UPDATES:
+      g_value_set_uint (value, self->merged_updates);
+      break;
+
+    case PROP_RESTART_COUNT:
+      g_value_set_uint (value, self->name_watch ? self->name_watch->restart_count : 0);
+      break;
+
+    case PROP_RECENT_RESTARTS:
+      g_value_set_uint (value, self->name_watch ? self->name_watch->restart_times->len : 0);
+      break;
+
+    case PROP_RESTART_BACKOFF:
+      g_value_set_uint (value, self->name_watch ? self->name_watch->restart_backoff : RESTART_BACKOFF_INITIAL);
+      break;
+
+    case PROP_MAX_UPDATE_RATE:
+      g_value_set_uint (value, self->max_update_rate);
+      break;
+
+    case PROP_DROPPED_UPDATES:
+      g_value_set_uint (value, self->dropped_updates);
+      break;
+
+    case PROP_MAX_SCROLLS_IN_FLIGHT:
+      g_value_set_uint (value, self->max_scrolls_in_flight);
+      break;
+
+    case PROP_HEADLESS:
+      g_value_set_boolean (value, self->headless);
+      break;
+
+    case PROP_LABEL:
+      g_value_set_string (value, indicator_ng_get_label (self));
+      break;
+
+    case PROP_ICON:
+      g_value_set_object (value, self->icon);
+      break;
+
+    case PROP_ACCESSIBLE_DESC:
+      g_value_set_string (value, self->accessible_desc);
+      break;
+
+    case PROP_MENU_MODEL:
+      g_value_set_object (value, self->popup);
+      break;
+
+    case PROP_CONNECTION:
+      g_value_set_object (value, self->connection);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
@@ -112,32 +411,126 @@ indicator_ng_set_property (GObject      *object,
       self->profile = g_strdup (g_value_get_string (value));
       break;
 
+    case PROP_INDEX_RECORD: /* construct-only */
+      self->index_record = g_value_get_pointer (value);
+      break;
+
+    case PROP_CONNECTION: /* construct-only */
+      self->connection = g_value_dup_object (value);
+      break;
+
+    case PROP_LAZY_MENU:
+      indicator_ng_set_lazy_menu (self, g_value_get_boolean (value));
+      break;
+
+    case PROP_PREWARM_MENU:
+      indicator_ng_set_prewarm_menu (self, g_value_get_boolean (value));
+      break;
+
+    case PROP_COALESCE_UPDATES:
+      indicator_ng_set_coalesce_updates (self, g_value_get_boolean (value));
+      break;
+
+    case PROP_MAX_UPDATE_RATE:
+      indicator_ng_set_max_update_rate (self, g_value_get_uint (value));
+      break;
+
+    case PROP_MAX_SCROLLS_IN_FLIGHT:
+      indicator_ng_set_max_scrolls_in_flight (self, g_value_get_uint (value));
+      break;
+
+    case PROP_HEADLESS: /* construct-only */
+      self->headless = g_value_get_boolean (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
 }
 
+/* Drops a header update that was queued by
+ * indicator_ng_queue_update_entry() without applying it */
+static gboolean
+indicator_ng_cancel_queued_update (IndicatorNg *self)
+{
+  gboolean pending = FALSE;
+
+  if (self->update_tick_id)
+    {
+      gtk_widget_remove_tick_callback (self->update_tick_widget, self->update_tick_id);
+      self->update_tick_id = 0;
+      self->update_tick_widget = NULL;
+      pending = TRUE;
+    }
+
+  if (self->update_idle_id)
+    {
+      g_source_remove (self->update_idle_id);
+      self->update_idle_id = 0;
+      pending = TRUE;
+    }
+
+  if (self->rate_limit_id)
+    {
+      g_source_remove (self->rate_limit_id);
+      self->rate_limit_id = 0;
+      pending = TRUE;
+    }
+
+  return pending;
+}
+
+static void
+indicator_ng_cancel_queued_scroll (IndicatorNg *self)
+{
+  if (self->scroll_tick_id)
+    {
+      gtk_widget_remove_tick_callback (self->scroll_tick_widget, self->scroll_tick_id);
+      self->scroll_tick_id = 0;
+      self->scroll_tick_widget = NULL;
+    }
+
+  if (self->scroll_idle_id)
+    {
+      g_source_remove (self->scroll_idle_id);
+      self->scroll_idle_id = 0;
+    }
+}
+
 static void
 indicator_ng_free_actions_and_menu (IndicatorNg *self)
 {
+  indicator_ng_cancel_queued_update (self);
+  indicator_ng_cancel_queued_scroll (self);
+
+  /* replies to scrolls sent to the old service don't matter anymore */
+  if (self->scroll_cancellable)
+    {
+      g_cancellable_cancel (self->scroll_cancellable);
+      g_clear_object (&self->scroll_cancellable);
+    }
+
+  self->scroll_delta = 0;
+  self->scrolls_in_flight = 0;
+  indicator_ng_prewarm_cancel (self);
+
+  if (self->popup)
+    {
+      g_clear_object (&self->popup);
+      g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MENU_MODEL]);
+    }
+
   if (self->actions)
     {
-      gtk_widget_insert_action_group (GTK_WIDGET (self->entry.menu), "indicator", NULL);
+      if (self->entry.menu)
+        gtk_widget_insert_action_group (GTK_WIDGET (self->entry.menu), "indicator", NULL);
       g_signal_handlers_disconnect_by_data (self->actions, self);
       g_clear_object (&self->actions);
     }
 
   if (self->menu)
     {
-        for (guint nMenuSection = 0; nMenuSection < MENU_SECTIONS; nMenuSection++)
-        {
-            if (self->lMenuSections[nMenuSection])
-            {
-                g_object_unref(self->lMenuSections[nMenuSection]);
-                self->lMenuSections[nMenuSection] = NULL;
-            }
-        }
-
+      g_clear_pointer (&self->pMenuSections, indicator_ng_menu_section_free);
       g_signal_handlers_disconnect_by_data (self->menu, self);
       g_clear_object (&self->menu);
     }
@@ -148,20 +541,22 @@ indicator_ng_dispose (GObject *object)
 {
   IndicatorNg *self = INDICATOR_NG (object);
 
-  if (self->name_watch_id)
-    {
-      g_bus_unwatch_name (self->name_watch_id);
-      self->name_watch_id = 0;
-    }
+  indicator_ng_unwatch_service (self);
 
-  g_clear_object (&self->session_bus);
+  g_clear_object (&self->connection);
 
   indicator_ng_free_actions_and_menu (self);
+  indicator_ng_prewarm_cancel (self);
+
+  if (self->entry.label)
+    g_signal_handlers_disconnect_by_data (self->entry.label, self);
+  if (self->entry.image)
+    g_signal_handlers_disconnect_by_data (self->entry.image, self);
 
-  g_clear_object (&self->label_css_provider);
   g_clear_object (&self->entry.label);
   g_clear_object (&self->entry.image);
   g_clear_object (&self->entry.menu);
+  g_clear_object (&self->icon);
 
   G_OBJECT_CLASS (indicator_ng_parent_class)->dispose (object);
 }
@@ -177,10 +572,12 @@ indicator_ng_finalize (GObject *object)
   g_free (self->menu_object_path);
   g_free (self->bus_name);
   g_free (self->accessible_desc);
+  indicator_ng_header_clear (&self->header);
   g_free (self->header_action);
   g_free (self->scroll_action);
   g_free (self->secondary_action);
   g_free (self->submenu_action);
+  g_free (self->name_owner);
 
   G_OBJECT_CLASS (indicator_ng_parent_class)->finalize (object);
 }
@@ -193,6 +590,16 @@ indicator_ng_get_entries (IndicatorObject *io)
   return g_list_append (NULL, &self->entry);
 }
 
+static void
+indicator_ng_foreach_entry (IndicatorObject          *io,
+                            IndicatorObjectEntryFunc  func,
+                            gpointer                  user_data)
+{
+  IndicatorNg *self = INDICATOR_NG (io);
+
+  func (io, &self->entry, user_data);
+}
+
 static gint
 indicator_ng_get_position (IndicatorObject *io)
 {
@@ -202,23 +609,179 @@ indicator_ng_get_position (IndicatorObject *io)
 }
 
 static void
-indicator_ng_entry_scrolled (IndicatorObject          *io,
-                             __attribute__((unused)) IndicatorObjectEntry     *entry,
-                             gint                      delta,
-                             IndicatorScrollDirection  direction)
+indicator_ng_get_stats (IndicatorObject *io,
+                        GVariantBuilder *builder)
 {
   IndicatorNg *self = INDICATOR_NG (io);
+  GVariantBuilder handler_time;
+  guint i;
+
+  g_signal_chain_from_overridden_handler (io, builder);
+
+  g_variant_builder_add (builder, "{sv}", "header-updates", g_variant_new_uint32 (self->header_updates));
+  g_variant_builder_add (builder, "{sv}", "merged-updates", g_variant_new_uint32 (self->merged_updates));
+  g_variant_builder_add (builder, "{sv}", "dropped-updates", g_variant_new_uint32 (self->dropped_updates));
+  g_variant_builder_add (builder, "{sv}", "icon-reloads", g_variant_new_uint32 (self->icon_reloads));
+  g_variant_builder_add (builder, "{sv}", "icon-cache-hits", g_variant_new_uint32 (self->icon_cache_hits));
+  g_variant_builder_add (builder, "{sv}", "menu-rebuilds", g_variant_new_uint32 (self->menu_rebuilds));
+  g_variant_builder_add (builder, "{sv}", "ido-recreations", g_variant_new_uint32 (self->ido_recreations));
+  /* restarts are the service's, shared by all of its indicators */
+  g_variant_builder_add (builder, "{sv}", "restarts",
+                         g_variant_new_uint32 (self->name_watch ? self->name_watch->restart_count : 0));
+  g_variant_builder_add (builder, "{sv}", "last-restart",
+                         g_variant_new_int64 (self->name_watch ? self->name_watch->last_restart_time : 0));
+
+  g_variant_builder_init (&handler_time, G_VARIANT_TYPE ("a{sx}"));
+  for (i = 0; i < N_HANDLERS; i++)
+    g_variant_builder_add (&handler_time, "{sx}", m_lHandlerNames[i], self->handler_time[i]);
+  g_variant_builder_add (builder, "{sv}", "handler-time", g_variant_builder_end (&handler_time));
+}
+
+static void indicator_ng_flush_scroll (IndicatorNg *self);
+
+static void
+indicator_ng_scroll_activated (GObject      *source_object,
+                               GAsyncResult *res,
+                               gpointer      user_data)
+{
+  IndicatorNg *self;
+  GError *error = NULL;
+  GVariant *result;
 
-  if (self->actions && self->scroll_action)
+  result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), res, &error);
+  if (result == NULL)
     {
-      if (direction == INDICATOR_OBJECT_SCROLL_DOWN ||
-          direction == INDICATOR_OBJECT_SCROLL_LEFT)
+      /* the indicator may be gone already */
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
         {
-          delta *= -1;
+          g_error_free (error);
+          return;
         }
 
+      g_warning ("unable to activate scroll action: %s", error->message);
+      g_error_free (error);
+    }
+  else
+    g_variant_unref (result);
+
+  self = user_data;
+  self->scrolls_in_flight--;
+
+  /* send what piled up while waiting */
+  indicator_ng_flush_scroll (self);
+}
+
+/* Sends the scroll delta accumulated since the last flush as a single
+ * activation. With a maximum number of activations in flight, the
+ * delta is kept until a reply makes room for it. */
+static void
+indicator_ng_flush_scroll (IndicatorNg *self)
+{
+  gint delta;
+
+  if (self->scroll_delta == 0 || !self->actions || !self->scroll_action)
+    return;
+
+  if (self->max_scrolls_in_flight && self->scrolls_in_flight >= self->max_scrolls_in_flight)
+    return;
+
+  delta = self->scroll_delta;
+  self->scroll_delta = 0;
+
+  if (!self->max_scrolls_in_flight)
+    {
       g_action_group_activate_action (self->actions, self->scroll_action,
                                       g_variant_new_int32 (delta));
+      return;
+    }
+
+  /* GActionGroup doesn't tell when an activation is done, so talk to
+   * the service the way GDBusActionGroup would */
+  {
+    GVariant *parameter = g_variant_new_variant (g_variant_new_int32 (delta));
+
+    self->scrolls_in_flight++;
+    g_dbus_connection_call (self->connection,
+                            self->name_owner,
+                            self->object_path,
+                            "org.gtk.Actions",
+                            "Activate",
+                            g_variant_new ("(s@av@a{sv})", self->scroll_action,
+                                           g_variant_new_array (G_VARIANT_TYPE_VARIANT, &parameter, 1),
+                                           g_variant_new_array (G_VARIANT_TYPE ("{sv}"), NULL, 0)),
+                            NULL,
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            self->scroll_cancellable,
+                            indicator_ng_scroll_activated,
+                            self);
+  }
+}
+
+static gboolean
+indicator_ng_scroll_tick (__attribute__((unused)) GtkWidget     *widget,
+                          __attribute__((unused)) GdkFrameClock *frame_clock,
+                          gpointer                               user_data)
+{
+  IndicatorNg *self = user_data;
+
+  self->scroll_tick_id = 0;
+  self->scroll_tick_widget = NULL;
+  indicator_ng_flush_scroll (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+indicator_ng_scroll_idle (gpointer user_data)
+{
+  IndicatorNg *self = user_data;
+
+  self->scroll_idle_id = 0;
+  indicator_ng_flush_scroll (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Scroll events are summed up and sent once per frame of the header
+ * widgets (or from the main loop while they aren't on screen), so that
+ * smooth scrolling doesn't turn into a flood of activations */
+static void
+indicator_ng_entry_scrolled (IndicatorObject          *io,
+                             __attribute__((unused)) IndicatorObjectEntry     *entry,
+                             gint                      delta,
+                             IndicatorScrollDirection  direction)
+{
+  IndicatorNg *self = INDICATOR_NG (io);
+  GtkWidget *widget = NULL;
+
+  if (!self->actions || !self->scroll_action)
+    return;
+
+  if (direction == INDICATOR_OBJECT_SCROLL_DOWN ||
+      direction == INDICATOR_OBJECT_SCROLL_LEFT)
+    {
+      delta *= -1;
+    }
+
+  self->scroll_delta += delta;
+
+  if (self->scroll_tick_id || self->scroll_idle_id)
+    return;
+
+  if (self->entry.image && gtk_widget_get_realized (GTK_WIDGET (self->entry.image)))
+    widget = GTK_WIDGET (self->entry.image);
+  else if (self->entry.label && gtk_widget_get_realized (GTK_WIDGET (self->entry.label)))
+    widget = GTK_WIDGET (self->entry.label);
+
+  if (widget)
+    {
+      self->scroll_tick_widget = widget;
+      self->scroll_tick_id = gtk_widget_add_tick_callback (widget, indicator_ng_scroll_tick, self, NULL);
+    }
+  else
+    {
+      self->scroll_idle_id = g_idle_add (indicator_ng_scroll_idle, self);
     }
 }
 
@@ -236,38 +799,89 @@ indicator_ng_secondary_activate (IndicatorObject      *io,
     }
 }
 
-static gboolean indicator_ng_menu_insert_idos(IndicatorNg *self, GMenuModel *pSection, guint nModelItem, guint nMenuItem, gboolean bNamespace, gchar *sNamespace)
+/* Creates the IDO widget for an item of type sType. The factory that
+ * handles a type is remembered, so only the first item of each type has
+ * to try all of them */
+static GtkMenuItem* indicator_ng_menu_create_ido(const gchar *sType, GMenuItem *pMenuModelItem, GActionGroup *pActionGroup)
+{
+    GtkMenuItem *pMenuItem = NULL;
+
+    if (!m_pIdoFactories)
+    {
+        m_pIdoFactories = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    }
+
+    AyatanaMenuItemFactory *pFactory = g_hash_table_lookup(m_pIdoFactories, sType);
+
+    if (pFactory)
+    {
+        return ayatana_menu_item_factory_create_menu_item(pFactory, sType, pMenuModelItem, pActionGroup);
+    }
+
+    // Unknown types are not remembered, so a failure doesn't stick to the type
+    for (GList *pLink = ayatana_menu_item_factory_get_all(); pLink != NULL && pMenuItem == NULL; pLink = pLink->next)
+    {
+        pMenuItem = ayatana_menu_item_factory_create_menu_item(pLink->data, sType, pMenuModelItem, pActionGroup);
+
+        if (pMenuItem)
+        {
+            g_hash_table_insert(m_pIdoFactories, g_strdup(sType), pLink->data);
+        }
+    }
+
+    return pMenuItem;
+}
+
+/* Returns the action name prefixed with the namespace of the section,
+ * as a value shared by all the items of the section using that action.
+ * The values live as long as the section does. */
+static GVariant* indicator_ng_menu_get_namespaced_action(IndicatorNgMenuSection *pSection, const gchar *sAction)
+{
+    if (!pSection->pNamespacedActions)
+    {
+        pSection->pNamespacedActions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+    }
+
+    GVariant *pAction = g_hash_table_lookup(pSection->pNamespacedActions, sAction);
+
+    if (!pAction)
+    {
+        gchar *sNamespacedAction = g_strconcat(pSection->sNamespace, ".", sAction, NULL);
+        pAction = g_variant_ref_sink(g_variant_new_string(sNamespacedAction));
+        g_hash_table_insert(pSection->pNamespacedActions, g_strdup(sAction), pAction);
+        g_free(sNamespacedAction);
+    }
+
+    return pAction;
+}
+
+static gboolean indicator_ng_menu_insert_idos(IndicatorNg *self, GPtrArray *lMenuItems, IndicatorNgMenuSection *pSection, guint nModelItem, guint nMenuItem)
 {
     gboolean bChanged = FALSE;
     gchar *sType;
-    gboolean bHasType = g_menu_model_get_item_attribute(pSection, nModelItem, "x-ayatana-type", "s", &sType);
+    gboolean bHasType = g_menu_model_get_item_attribute(pSection->pModel, nModelItem, "x-ayatana-type", "s", &sType);
 
     if (bHasType)
     {
-        GList *lMenuItems = gtk_container_get_children(GTK_CONTAINER(self->entry.menu));
-        GtkWidget *pMenuItemOld = GTK_WIDGET(g_list_nth_data(lMenuItems, nMenuItem));
-        const gchar *sName = gtk_widget_get_name(pMenuItemOld);
+        GtkWidget *pMenuItemOld = nMenuItem < lMenuItems->len ? g_ptr_array_index(lMenuItems, nMenuItem) : NULL;
+        const gchar *sName = pMenuItemOld ? gtk_widget_get_name(pMenuItemOld) : NULL;
 
         if (sName != NULL && !g_str_equal(sName, sType))
         {
             GActionGroup *pActionGroup = (GActionGroup*)g_object_get_qdata(G_OBJECT(self->entry.menu), m_pActionMuxer);
-            GMenuItem *pMenuModelItem = g_menu_item_new_from_model(pSection, nModelItem);
+            GMenuItem *pMenuModelItem = g_menu_item_new_from_model(pSection->pModel, nModelItem);
             GtkMenuItem* pMenuItemNew = NULL;
-            gchar *sAction;
+            GVariant *pAction = pSection->sNamespace ? g_menu_item_get_attribute_value(pMenuModelItem, G_MENU_ATTRIBUTE_ACTION, G_VARIANT_TYPE_STRING) : NULL;
 
-            if (bNamespace && g_menu_item_get_attribute(pMenuModelItem, G_MENU_ATTRIBUTE_ACTION, "s", &sAction))
+            if (pAction)
             {
-                gchar *sNamespacedAction = g_strconcat(sNamespace, ".", sAction, NULL);
-                g_menu_item_set_attribute(pMenuModelItem, G_MENU_ATTRIBUTE_ACTION, "s", sNamespacedAction);
-                g_free (sNamespacedAction);
-                g_free (sAction);
+                g_menu_item_set_attribute_value(pMenuModelItem, G_MENU_ATTRIBUTE_ACTION, indicator_ng_menu_get_namespaced_action(pSection, g_variant_get_string(pAction, NULL)));
+                g_variant_unref(pAction);
             }
 
-            for (GList *pFactory = ayatana_menu_item_factory_get_all(); pFactory != NULL && pMenuItemNew == NULL; pFactory = pFactory->next)
-            {
-                pMenuItemNew = ayatana_menu_item_factory_create_menu_item(pFactory->data, sType, pMenuModelItem, pActionGroup);
-                bChanged = TRUE;
-            }
+            pMenuItemNew = indicator_ng_menu_create_ido(sType, pMenuModelItem, pActionGroup);
+            bChanged = TRUE;
+            self->ido_recreations++;
 
             if (pMenuItemNew == NULL)
             {
@@ -278,154 +892,394 @@ static gboolean indicator_ng_menu_insert_idos(IndicatorNg *self, GMenuModel *pSe
             gtk_widget_show(GTK_WIDGET(pMenuItemNew));
             gtk_container_remove(GTK_CONTAINER(self->entry.menu), pMenuItemOld);
             gtk_menu_shell_insert(GTK_MENU_SHELL(self->entry.menu), GTK_WIDGET(pMenuItemNew), nMenuItem);
+            g_ptr_array_index(lMenuItems, nMenuItem) = pMenuItemNew;
             g_object_unref(pMenuModelItem);
         }
 
-        g_list_free(lMenuItems);
         g_free(sType);
     }
 
     return bChanged;
 }
 
-static void indicator_ng_menu_size_allocate(__attribute__((unused)) GtkWidget *pWidget, __attribute__((unused)) GtkAllocation *pAllocation, gpointer pUserData)
+static void indicator_ng_workarea_invalidate(void)
 {
-    IndicatorNg *self = pUserData;
-    GList *pMenuItem = gtk_container_get_children(GTK_CONTAINER(self->entry.menu));
-    guint nWidth = 0;
-    guint nHeight = 0;
-    GdkWindow *pWindowBin = NULL;
+    m_bWorkareaValid = FALSE;
 
-    while (pMenuItem)
+    if (m_pWorkareaMonitor)
     {
-        if (!pWindowBin)
+        g_signal_handlers_disconnect_by_func(m_pWorkareaMonitor, indicator_ng_workarea_invalidate, NULL);
+        g_clear_object(&m_pWorkareaMonitor);
+    }
+}
+
+/* The workarea of the primary monitor, cached until the monitor setup
+ * or the workarea itself changes */
+static void indicator_ng_get_workarea(GdkRectangle *pRectangle)
+{
+    if (!m_bWorkareaValid)
+    {
+        GdkDisplay *pDisplay = gdk_display_get_default();
+
+        if (!m_bWorkareaWatched)
         {
-            pWindowBin = gtk_widget_get_parent_window(pMenuItem->data);
+            g_signal_connect_swapped(pDisplay, "monitor-added", G_CALLBACK(indicator_ng_workarea_invalidate), NULL);
+            g_signal_connect_swapped(pDisplay, "monitor-removed", G_CALLBACK(indicator_ng_workarea_invalidate), NULL);
+            g_signal_connect_swapped(gdk_display_get_default_screen(pDisplay), "monitors-changed", G_CALLBACK(indicator_ng_workarea_invalidate), NULL);
+            m_bWorkareaWatched = TRUE;
         }
 
-        gint nWidthNat;
-        gint nHeightNat;
-        gtk_widget_get_preferred_width(pMenuItem->data, NULL, &nWidthNat);
-        gtk_widget_get_preferred_height(pMenuItem->data, NULL, &nHeightNat);
-        nWidth = MAX((gint)nWidth, nWidthNat);
-        nHeight += nHeightNat;
-        GtkBorder cPadding;
-        GtkStyleContext *pContext = gtk_widget_get_style_context(GTK_WIDGET(pMenuItem->data));
-        gtk_style_context_get_padding(pContext, gtk_style_context_get_state(pContext), &cPadding);
-        nWidth += cPadding.left + cPadding.right;
-        pMenuItem = g_list_next(pMenuItem);
-    }
+        GdkMonitor *pMonitor = gdk_display_get_primary_monitor(pDisplay);
 
-    g_list_free(pMenuItem);
-    GtkBorder cPadding;
-    GtkStyleContext *pContext = gtk_widget_get_style_context(GTK_WIDGET(self->entry.menu));
-    gtk_style_context_get_padding(pContext, gtk_style_context_get_state(pContext), &cPadding);
-    gint nBorderWidth = gtk_container_get_border_width(GTK_CONTAINER(self->entry.menu));
-    gint nIconWidth;
-    gtk_icon_size_lookup(GTK_ICON_SIZE_MENU, &nIconWidth, NULL);
-    nWidth += (2 * nBorderWidth) + cPadding.left + cPadding.right + (nIconWidth * 3) / 2;
-    nHeight += (2 * nBorderWidth) + cPadding.top + cPadding.bottom + (nIconWidth * 3) / 4;
+        if (!pMonitor)
+        {
+            pMonitor = gdk_display_get_monitor(pDisplay, 0);
+        }
 
-    GdkRectangle cRectangle = {0};
-    GdkDisplay *pDisplay = gdk_display_get_default();
-    GdkMonitor *pMonitor = gdk_display_get_primary_monitor(pDisplay);
-    gdk_monitor_get_workarea(pMonitor, &cRectangle);
+        m_cWorkarea = (GdkRectangle){0};
 
-    if ((gint)nHeight <= cRectangle.height)
-    {
-        gdk_window_move_resize(pWindowBin, 0, 0, nWidth, nHeight);
+        if (pMonitor)
+        {
+            gdk_monitor_get_workarea(pMonitor, &m_cWorkarea);
+            m_pWorkareaMonitor = g_object_ref(pMonitor);
+            g_signal_connect_swapped(m_pWorkareaMonitor, "notify::workarea", G_CALLBACK(indicator_ng_workarea_invalidate), NULL);
+        }
+
+        m_bWorkareaValid = TRUE;
     }
 
-    nHeight = MIN((gint)nHeight, cRectangle.height);
+    *pRectangle = m_cWorkarea;
+}
 
-    GdkWindow *pWindow = gtk_widget_get_parent_window(GTK_WIDGET(self->entry.menu));
-    gdk_window_resize(pWindow, nWidth, nHeight);
+static void indicator_ng_menu_item_size_invalidate(GtkWidget *pMenuItem)
+{
+    IndicatorNgItemSize *pSize = g_object_get_qdata(G_OBJECT(pMenuItem), m_pItemSize);
 
-    gtk_menu_reposition(self->entry.menu);
+    if (pSize)
+    {
+        pSize->bValid = FALSE;
+    }
 }
 
-static void indicator_ng_menu_section_changed(__attribute__((unused)) GMenuModel *pMenuSection, __attribute__((unused)) gint nPosition, __attribute__((unused)) gint nRemoved, __attribute__((unused)) gint nAdded, gpointer pUserData)
+/* The measurement of a single menu item. The requested size is taken
+ * from GTK every time: its own request cache is dropped whenever the
+ * item or anything inside it queues a resize, which is not the case
+ * for ours, an IDO changing a child label or image notifies nothing on
+ * the item. Only the style padding is kept, until the item or its
+ * style changes, or the menu was hidden. */
+static const IndicatorNgItemSize* indicator_ng_menu_item_get_size(IndicatorNg *self, GtkWidget *pMenuItem)
 {
-    IndicatorNg *self = pUserData;
-    GMenuModel *pModel = g_menu_model_get_item_link(self->menu, 0, G_MENU_LINK_SUBMENU);
-    guint nMenuItem = 0;
-    gboolean bChanged = FALSE;
+    IndicatorNgItemSize *pSize = g_object_get_qdata(G_OBJECT(pMenuItem), m_pItemSize);
 
-    if (pModel)
+    if (!pSize)
     {
-        guint nSections = g_menu_model_get_n_items(pModel);
+        pSize = g_new0(IndicatorNgItemSize, 1);
+        g_object_set_qdata_full(G_OBJECT(pMenuItem), m_pItemSize, pSize, g_free);
+        g_signal_connect(pMenuItem, "notify", G_CALLBACK(indicator_ng_menu_item_size_invalidate), NULL);
+        g_signal_connect(pMenuItem, "style-updated", G_CALLBACK(indicator_ng_menu_item_size_invalidate), NULL);
+    }
 
-        for (guint nSection = 0; nSection < nSections; nSection++)
-        {
-            GMenuModel *pSection = g_menu_model_get_item_link(pModel, nSection, G_MENU_LINK_SECTION);
-            guint nSubsections = 0;
+    gtk_widget_get_preferred_width(pMenuItem, NULL, &pSize->nWidth);
+    gtk_widget_get_preferred_height(pMenuItem, NULL, &pSize->nHeight);
 
-            if (pSection)
+    if (!pSize->bValid || pSize->nGeneration != self->nMenuGeneration)
+    {
+        GtkBorder cPadding;
+        GtkStyleContext *pContext = gtk_widget_get_style_context(pMenuItem);
+        gtk_style_context_get_padding(pContext, gtk_style_context_get_state(pContext), &cPadding);
+        pSize->nPadding = cPadding.left + cPadding.right;
+        pSize->nGeneration = self->nMenuGeneration;
+        pSize->bValid = TRUE;
+    }
+
+    return pSize;
+}
+
+static void indicator_ng_menu_style_changed(IndicatorNg *self)
+{
+    self->bMenuMetricsValid = FALSE;
+}
+
+static void indicator_ng_menu_size_allocate(__attribute__((unused)) GtkWidget *pWidget, __attribute__((unused)) GtkAllocation *pAllocation, gpointer pUserData)
+{
+    IndicatorNg *self = pUserData;
+    INDICATOR_TRACE_SCOPE("menu-size-allocate", self->name);
+    INDICATOR_NG_TIME_HANDLER(self, HANDLER_MENU_SIZE_ALLOCATE);
+
+    // Resizing and repositioning below allocates the menu again, don't follow that cascade
+    if (self->bMenuAllocating)
+    {
+        return;
+    }
+
+    GList *lMenuItems = gtk_container_get_children(GTK_CONTAINER(self->entry.menu));
+    guint nWidth = 0;
+    guint nHeight = 0;
+    GdkWindow *pWindowBin = NULL;
+
+    for (GList *pMenuItem = lMenuItems; pMenuItem != NULL; pMenuItem = pMenuItem->next)
+    {
+        if (!pWindowBin)
+        {
+            pWindowBin = gtk_widget_get_parent_window(pMenuItem->data);
+        }
+
+        const IndicatorNgItemSize *pSize = indicator_ng_menu_item_get_size(self, pMenuItem->data);
+        nWidth = MAX((gint)nWidth, pSize->nWidth);
+        nHeight += pSize->nHeight;
+        nWidth += pSize->nPadding;
+    }
+
+    g_list_free(lMenuItems);
+
+    if (!self->bMenuMetricsValid)
+    {
+        GtkBorder cPadding;
+        GtkStyleContext *pContext = gtk_widget_get_style_context(GTK_WIDGET(self->entry.menu));
+        gtk_style_context_get_padding(pContext, gtk_style_context_get_state(pContext), &cPadding);
+        gint nBorderWidth = gtk_container_get_border_width(GTK_CONTAINER(self->entry.menu));
+        gint nIconWidth;
+        gtk_icon_size_lookup(GTK_ICON_SIZE_MENU, &nIconWidth, NULL);
+        self->nMenuExtraWidth = (2 * nBorderWidth) + cPadding.left + cPadding.right + (nIconWidth * 3) / 2;
+        self->nMenuExtraHeight = (2 * nBorderWidth) + cPadding.top + cPadding.bottom + (nIconWidth * 3) / 4;
+        self->bMenuMetricsValid = TRUE;
+    }
+
+    nWidth += self->nMenuExtraWidth;
+    nHeight += self->nMenuExtraHeight;
+
+    GdkRectangle cRectangle;
+    indicator_ng_get_workarea(&cRectangle);
+
+    GdkWindow *pWindow = gtk_widget_get_parent_window(GTK_WIDGET(self->entry.menu));
+    gboolean bResized = FALSE;
+    self->bMenuAllocating = TRUE;
+
+    if (pWindowBin && (gint)nHeight <= cRectangle.height && (gdk_window_get_width(pWindowBin) != (gint)nWidth || gdk_window_get_height(pWindowBin) != (gint)nHeight))
+    {
+        gdk_window_move_resize(pWindowBin, 0, 0, nWidth, nHeight);
+        bResized = TRUE;
+    }
+
+    nHeight = MIN((gint)nHeight, cRectangle.height);
+
+    if (pWindow && (gdk_window_get_width(pWindow) != (gint)nWidth || gdk_window_get_height(pWindow) != (gint)nHeight))
+    {
+        gdk_window_resize(pWindow, nWidth, nHeight);
+        bResized = TRUE;
+    }
+
+    if (bResized)
+    {
+        gtk_menu_reposition(self->entry.menu);
+    }
+
+    self->bMenuAllocating = FALSE;
+}
+
+static void indicator_ng_menu_section_changed(GMenuModel *pModel, gint nPosition, gint nRemoved, gint nAdded, gpointer pUserData);
+
+static void indicator_ng_menu_section_free(gpointer pData)
+{
+    IndicatorNgMenuSection *pSection = pData;
+
+    g_signal_handler_disconnect(pSection->pModel, pSection->nHandler);
+    g_ptr_array_unref(pSection->lChildren);
+    g_array_unref(pSection->lPositions);
+    g_clear_pointer(&pSection->pNamespacedActions, g_hash_table_unref);
+    g_object_unref(pSection->pModel);
+    g_slice_free(IndicatorNgMenuSection, pSection);
+}
+
+static IndicatorNgMenuSection* indicator_ng_menu_section_new(IndicatorNg *self, IndicatorNgMenuSection *pParent, GMenuModel *pModel, const gchar *sNamespace);
+
+/* Creates the nodes of the sections linked from nAdded items starting
+ * at nPosition, and inserts them (or NULL) into the parent's slots */
+static void indicator_ng_menu_section_add_children(IndicatorNgMenuSection *pSection, guint nPosition, guint nAdded)
+{
+    for (guint nItem = nPosition; nItem < nPosition + nAdded; nItem++)
+    {
+        IndicatorNgMenuSection *pChild = NULL;
+
+        if (pSection->nDepth < MENU_SECTION_DEPTH)
+        {
+            GMenuModel *pModel = g_menu_model_get_item_link(pSection->pModel, nItem, G_MENU_LINK_SECTION);
+
+            if (pModel)
             {
-                gchar *sNamespace;
-                gboolean bNamespace = g_menu_model_get_item_attribute(pModel, nSection, G_MENU_ATTRIBUTE_ACTION_NAMESPACE, "s", &sNamespace);
-                nSubsections = g_menu_model_get_n_items(pSection);
+                gchar *sNamespace = NULL;
 
-                for (guint nSubsection = 0; nSubsection < nSubsections; nSubsection++)
+                // Sections inherit the action namespace of the root item linking them
+                if (!pSection->pParent)
                 {
-                    GMenuModel *pSubsection = g_menu_model_get_item_link(pSection, nSubsection, G_MENU_LINK_SECTION);
+                    g_menu_model_get_item_attribute(pSection->pModel, nItem, G_MENU_ATTRIBUTE_ACTION_NAMESPACE, "s", &sNamespace);
+                }
+
+                pChild = indicator_ng_menu_section_new(pSection->pIndicator, pSection, pModel, pSection->pParent ? pSection->sNamespace : sNamespace);
+                g_free(sNamespace);
+                g_object_unref(pModel);
+            }
+        }
+
+        g_ptr_array_insert(pSection->lChildren, nItem, pChild);
+    }
+}
+
+static IndicatorNgMenuSection* indicator_ng_menu_section_new(IndicatorNg *self, IndicatorNgMenuSection *pParent, GMenuModel *pModel, const gchar *sNamespace)
+{
+    IndicatorNgMenuSection *pSection = g_slice_new0(IndicatorNgMenuSection);
 
-                    if (pSubsection)
-                    {
-                        guint nItems = g_menu_model_get_n_items(pSubsection);
+    pSection->pIndicator = self;
+    pSection->pParent = pParent;
+    pSection->pModel = g_object_ref(pModel);
+    pSection->sNamespace = g_intern_string(sNamespace);
+    pSection->nDepth = pParent ? pParent->nDepth + 1 : 0;
+    pSection->lPositions = g_array_new(FALSE, FALSE, sizeof(guint));
 
-                        // Skip the subsection separator (if there is one)
-                        GList *lMenuItems = gtk_container_get_children(GTK_CONTAINER(self->entry.menu));
-                        GtkWidget *pMenuItem = GTK_WIDGET(g_list_nth_data(lMenuItems, nMenuItem));
+    guint nItems = g_menu_model_get_n_items(pModel);
+    pSection->lChildren = g_ptr_array_new_full(nItems, indicator_ng_menu_section_free);
+    indicator_ng_menu_section_add_children(pSection, 0, nItems);
+    pSection->nHandler = g_signal_connect(pModel, "items-changed", G_CALLBACK(indicator_ng_menu_section_changed), pSection);
 
-                        if (GTK_IS_SEPARATOR_MENU_ITEM(pMenuItem))
-                        {
-                            nMenuItem++;
-                        }
+    return pSection;
+}
 
-                        g_list_free(lMenuItems);
+/* Maps every model position of the popup's sections to the index of the
+ * widget GtkMenuShell created for it. This only walks the section tree
+ * and the given snapshot of the menu's children, so it is cheap compared
+ * to touching the widgets themselves. */
+static void indicator_ng_menu_section_update_positions(IndicatorNgMenuSection *pRoot, GPtrArray *lMenuItems)
+{
+    gboolean bMessages = g_str_equal(pRoot->pIndicator->name, "ayatana-indicator-messages");
+    guint nMenuItem = 0;
 
-                        for (guint nItem = 0; nItem < nItems; nItem++)
-                        {
-                            bChanged = indicator_ng_menu_insert_idos(self, pSubsection, nItem, nMenuItem, bNamespace, sNamespace) || bChanged;
-                            nMenuItem++;
-                        }
-                    }
+    for (guint nSection = 0; nSection < pRoot->lChildren->len; nSection++)
+    {
+        IndicatorNgMenuSection *pSection = g_ptr_array_index(pRoot->lChildren, nSection);
 
-                    g_object_unref(pSubsection);
+        if (!pSection)
+        {
+            continue;
+        }
 
-                    bChanged = indicator_ng_menu_insert_idos(self, pSection, nSubsection, nMenuItem, bNamespace, sNamespace) || bChanged;
+        g_array_set_size(pSection->lPositions, 0);
 
-                    if (!g_str_equal(self->name, "ayatana-indicator-messages"))
-                    {
-                        nMenuItem++;
-                    }
-                }
+        for (guint nSubsection = 0; nSubsection < pSection->lChildren->len; nSubsection++)
+        {
+            IndicatorNgMenuSection *pSubsection = g_ptr_array_index(pSection->lChildren, nSubsection);
+
+            if (pSubsection)
+            {
+                g_array_set_size(pSubsection->lPositions, 0);
 
-                if (bNamespace)
+                // Skip the subsection separator (if there is one)
+                if (nMenuItem < lMenuItems->len && GTK_IS_SEPARATOR_MENU_ITEM(g_ptr_array_index(lMenuItems, nMenuItem)))
                 {
-                    g_free(sNamespace);
+                    nMenuItem++;
                 }
 
-                g_object_unref(pSection);
+                for (guint nItem = 0; nItem < pSubsection->lChildren->len; nItem++)
+                {
+                    g_array_append_val(pSubsection->lPositions, nMenuItem);
+                    nMenuItem++;
+                }
             }
 
-            if (pSection && nSubsections)
+            g_array_append_val(pSection->lPositions, nMenuItem);
+
+            if (!bMessages)
             {
                 nMenuItem++;
             }
         }
 
-        g_object_unref(pModel);
+        if (pSection->lChildren->len)
+        {
+            nMenuItem++;
+        }
+    }
+}
+
+static gboolean indicator_ng_menu_reconcile(GPtrArray *lMenuItems, IndicatorNgMenuSection *pSection, guint nPosition, guint nAdded)
+{
+    gboolean bChanged = FALSE;
+    guint nEnd = MIN(nPosition + nAdded, pSection->lChildren->len);
+
+    for (guint nItem = nPosition; nItem < nEnd; nItem++)
+    {
+        IndicatorNgMenuSection *pChild = g_ptr_array_index(pSection->lChildren, nItem);
+
+        if (pChild)
+        {
+            bChanged = indicator_ng_menu_reconcile(lMenuItems, pChild, 0, pChild->lChildren->len) || bChanged;
+        }
+
+        // The items of the root model are sections, they have no widget of their own
+        if (pSection->pParent && nItem < pSection->lPositions->len)
+        {
+            guint nMenuItem = g_array_index(pSection->lPositions, guint, nItem);
+            bChanged = indicator_ng_menu_insert_idos(pSection->pIndicator, lMenuItems, pSection, nItem, nMenuItem) || bChanged;
+        }
+    }
+
+    return bChanged;
+}
+
+static GPtrArray* indicator_ng_menu_get_items(IndicatorNg *self)
+{
+    GList *lChildren = gtk_container_get_children(GTK_CONTAINER(self->entry.menu));
+    GPtrArray *lMenuItems = g_ptr_array_sized_new(g_list_length(lChildren));
+
+    for (GList *pChild = lChildren; pChild != NULL; pChild = pChild->next)
+    {
+        g_ptr_array_add(lMenuItems, pChild->data);
+    }
+
+    g_list_free(lChildren);
+
+    return lMenuItems;
+}
+
+static void indicator_ng_menu_section_changed(__attribute__((unused)) GMenuModel *pModel, gint nPosition, gint nRemoved, gint nAdded, gpointer pUserData)
+{
+    IndicatorNgMenuSection *pSection = pUserData;
+    IndicatorNg *self = pSection->pIndicator;
+    IndicatorNgMenuSection *pRoot = pSection;
+    INDICATOR_TRACE_SCOPE("menu-section-changed", self->name);
+    INDICATOR_NG_TIME_HANDLER(self, HANDLER_MENU_SECTION_CHANGED);
+
+    while (pRoot->pParent)
+    {
+        pRoot = pRoot->pParent;
+    }
+
+    // Follow the sections that came and went, this (un)subscribes them
+    g_ptr_array_remove_range(pSection->lChildren, nPosition, nRemoved);
+    indicator_ng_menu_section_add_children(pSection, nPosition, nAdded);
+
+    GPtrArray *lMenuItems = indicator_ng_menu_get_items(self);
+
+    // Replacing items inside a subsection doesn't shift any widget, so the positions are still valid
+    if (pSection->nDepth != MENU_SECTION_DEPTH || nRemoved != nAdded)
+    {
+        indicator_ng_menu_section_update_positions(pRoot, lMenuItems);
     }
 
+    // Only the inserted items (and the sections they link) can have new widgets
+    gboolean bChanged = indicator_ng_menu_reconcile(lMenuItems, pSection, nPosition, nAdded);
+
+    g_ptr_array_unref(lMenuItems);
+
     if (bChanged)
     {
         indicator_ng_menu_size_allocate(NULL, NULL, self);
     }
+
+    // Measure what arrived after the warm-up
+    indicator_ng_prewarm_schedule(self);
 }
 
-static void indicator_ng_set_tooltip(IndicatorNg *self, gchar *sTooltip)
+static void indicator_ng_set_tooltip(IndicatorNg *self, const gchar *sTooltip)
 {
     if (self->entry.label != NULL)
     {
@@ -438,47 +1292,65 @@ static void indicator_ng_set_tooltip(IndicatorNg *self, gchar *sTooltip)
     }
 }
 
+/* Starts tracking the sections of the bound popup, leaving the
+ * replacement of their widgets to the caller */
+static gboolean indicator_ng_menu_track_sections(IndicatorNg *self)
+{
+    if (self->pMenuSections || !self->menu)
+    {
+        return FALSE;
+    }
+
+    GMenuModel *pModel = g_menu_model_get_item_link(self->menu, 0, G_MENU_LINK_SUBMENU);
+
+    if (!pModel)
+    {
+        return FALSE;
+    }
+
+    self->pMenuSections = indicator_ng_menu_section_new(self, NULL, pModel, NULL);
+    g_object_unref(pModel);
+
+    GPtrArray *lMenuItems = indicator_ng_menu_get_items(self);
+    indicator_ng_menu_section_update_positions(self->pMenuSections, lMenuItems);
+    g_ptr_array_unref(lMenuItems);
+
+    return TRUE;
+}
+
 static void indicator_ng_menu_shown(__attribute__((unused)) GtkWidget *pWidget, gpointer pUserData)
 {
     IndicatorNg *self = pUserData;
-    guint nSectionCount = 0;
+    guint nSection = G_MAXUINT;
     self->bMenuShown = TRUE;
 
+    // A lazy popup that wasn't prefetched on hover is fetched now
+    indicator_ng_request_menu(self);
+
     indicator_ng_set_tooltip(self, NULL);
 
-    if (!self->lMenuSections[0])
+    if (indicator_ng_menu_track_sections(self))
     {
-        self->lMenuSections[0] = g_menu_model_get_item_link(self->menu, 0, G_MENU_LINK_SUBMENU);
-
-        if (self->lMenuSections[0])
-        {
-            guint nSections = g_menu_model_get_n_items(self->lMenuSections[0]);
+        nSection = 0;
+    }
+    else if (self->nPrewarmId && self->nPrewarmStep == PREWARM_SECTIONS)
+    {
+        // Finish what the warm-up didn't get to
+        nSection = self->nPrewarmIndex;
+    }
 
-            for (guint nSection = 0; nSection < nSections; nSection++)
-            {
-                self->lMenuSections[++nSectionCount] = g_menu_model_get_item_link(self->lMenuSections[0], nSection, G_MENU_LINK_SECTION);
+    indicator_ng_prewarm_cancel(self);
 
-                if (self->lMenuSections[nSectionCount])
-                {
-                    g_signal_connect(self->lMenuSections[nSectionCount], "items-changed", G_CALLBACK(indicator_ng_menu_section_changed), self);
-                    guint nSubsections = g_menu_model_get_n_items(self->lMenuSections[nSectionCount]);
-                    guint nParent = nSectionCount;
-
-                    for (guint nSubsection = 0; nSubsection < nSubsections; nSubsection++)
-                    {
-                        self->lMenuSections[++nSectionCount] = g_menu_model_get_item_link(self->lMenuSections[nParent], nSubsection, G_MENU_LINK_SECTION);
-
-                        if (self->lMenuSections[nSectionCount])
-                        {
-                            g_signal_connect(self->lMenuSections[nSectionCount], "items-changed", G_CALLBACK(indicator_ng_menu_section_changed), self);
-                        }
-                    }
-                }
-            }
+    if (self->pMenuSections && nSection < self->pMenuSections->lChildren->len)
+    {
+        GPtrArray *lMenuItems = indicator_ng_menu_get_items(self);
 
-            g_signal_connect(self->lMenuSections[0], "items-changed", G_CALLBACK(indicator_ng_menu_section_changed), self);
-            indicator_ng_menu_section_changed(self->lMenuSections[0], 0, 0, 1, self);
+        if (indicator_ng_menu_reconcile(lMenuItems, self->pMenuSections, nSection, self->pMenuSections->lChildren->len - nSection))
+        {
+            indicator_ng_menu_size_allocate(NULL, NULL, self);
         }
+
+        g_ptr_array_unref(lMenuItems);
     }
 
     if (self->submenu_action)
@@ -494,11 +1366,103 @@ indicator_ng_menu_hidden (__attribute__((unused)) GtkWidget *widget,
   IndicatorNg *self = user_data;
   self->bMenuShown = FALSE;
 
+  /* measure everything again the next time the menu is shown */
+  self->nMenuGeneration++;
+  self->bMenuMetricsValid = FALSE;
+
   if (self->submenu_action)
     g_action_group_change_action_state (self->actions, self->submenu_action,
                                         g_variant_new_boolean (FALSE));
 
-  indicator_ng_set_tooltip(self, self->sTooltip);
+  indicator_ng_set_tooltip(self, self->header.tooltip);
+}
+
+static void indicator_ng_prewarm_cancel(IndicatorNg *self)
+{
+    if (self->nPrewarmId)
+    {
+        g_source_remove(self->nPrewarmId);
+        self->nPrewarmId = 0;
+    }
+}
+
+/* Prepares the popup for its first opening in slices of at most
+ * MENU_PREWARM_BUDGET: the IDO widgets are created section by section,
+ * then the menu is realized and its items are measured one by one */
+static gboolean indicator_ng_prewarm(gpointer pUserData)
+{
+    IndicatorNg *self = pUserData;
+    gint64 nDeadline = g_get_monotonic_time() + MENU_PREWARM_BUDGET;
+    GPtrArray *lMenuItems = indicator_ng_menu_get_items(self);
+
+    do
+    {
+        if (self->nPrewarmStep == PREWARM_TRACK)
+        {
+            indicator_ng_menu_track_sections(self);
+            self->nPrewarmStep = PREWARM_SECTIONS;
+            self->nPrewarmIndex = 0;
+        }
+        else if (self->nPrewarmStep == PREWARM_SECTIONS)
+        {
+            if (self->pMenuSections && self->nPrewarmIndex < self->pMenuSections->lChildren->len)
+            {
+                if (indicator_ng_menu_reconcile(lMenuItems, self->pMenuSections, self->nPrewarmIndex, 1))
+                {
+                    g_ptr_array_unref(lMenuItems);
+                    lMenuItems = indicator_ng_menu_get_items(self);
+                }
+
+                self->nPrewarmIndex++;
+            }
+            else
+            {
+                self->nPrewarmStep = PREWARM_REALIZE;
+            }
+        }
+        else if (self->nPrewarmStep == PREWARM_REALIZE)
+        {
+            gtk_widget_realize(GTK_WIDGET(self->entry.menu));
+            self->nPrewarmStep = PREWARM_MEASURE;
+            self->nPrewarmIndex = 0;
+        }
+        else if (self->nPrewarmIndex < lMenuItems->len)
+        {
+            indicator_ng_menu_item_get_size(self, g_ptr_array_index(lMenuItems, self->nPrewarmIndex));
+            self->nPrewarmIndex++;
+        }
+        else
+        {
+            g_ptr_array_unref(lMenuItems);
+            self->nPrewarmId = 0;
+
+            return G_SOURCE_REMOVE;
+        }
+    }
+    while (g_get_monotonic_time() < nDeadline);
+
+    g_ptr_array_unref(lMenuItems);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void indicator_ng_prewarm_schedule(IndicatorNg *self)
+{
+    if (!self->bPrewarmMenu || self->bMenuShown || self->nPrewarmId || !self->menu || !self->entry.menu)
+    {
+        return;
+    }
+
+    // Don't fetch a popup that is held back
+    if (self->lazy_menu && !self->menu_requested)
+    {
+        return;
+    }
+
+    // With the sections already tracked, only the measuring is left to do
+    self->nPrewarmStep = self->pMenuSections ? PREWARM_REALIZE : PREWARM_TRACK;
+    self->nPrewarmIndex = 0;
+    self->nPrewarmId = g_idle_add_full(G_PRIORITY_LOW, indicator_ng_prewarm, self, NULL);
 }
 
 static void
@@ -510,13 +1474,85 @@ indicator_ng_set_accessible_desc (IndicatorNg *self,
 
   self->entry.accessible_desc = self->accessible_desc;
   g_signal_emit_by_name (self, INDICATOR_OBJECT_SIGNAL_ACCESSIBLE_DESC_UPDATE, &self->entry);
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_ACCESSIBLE_DESC]);
+}
+
+static void indicator_ng_icon_cache_entry_free(gpointer pData)
+{
+    IndicatorNgIconCacheEntry *pEntry = pData;
+
+    g_variant_unref(pEntry->pVariant);
+    g_object_unref(pEntry->pIcon);
+    g_slice_free(IndicatorNgIconCacheEntry, pEntry);
+}
+
+/* g_variant_hash() only takes basic types, while serialized icons are
+ * mostly (sv) containers, so hash what they serialize to instead */
+static guint indicator_ng_icon_cache_hash(gconstpointer pKey)
+{
+    GBytes *pBytes = g_variant_get_data_as_bytes((GVariant*) pKey);
+    guint nHash = g_bytes_hash(pBytes);
+
+    g_bytes_unref(pBytes);
+
+    return nHash;
+}
+
+/* Returns the cache entry of an icon variant, deserializing it only if
+ * it isn't among the ICON_CACHE_SIZE most recently used ones. The cache
+ * is shared by all indicators, as the same icons tend to be used by
+ * several of them, and over and over again by the same one. bHit tells
+ * whether the entry was there already. */
+static IndicatorNgIconCacheEntry* indicator_ng_icon_cache_lookup(GVariant *pVariant, gboolean *bHit)
+{
+    if (!m_pIconCache)
+    {
+        m_pIconCache = g_hash_table_new(indicator_ng_icon_cache_hash, g_variant_equal);
+    }
+
+    GList *pLink = g_hash_table_lookup(m_pIconCache, pVariant);
+
+    *bHit = pLink != NULL;
+
+    if (pLink)
+    {
+        g_queue_unlink(&m_lIconCacheLru, pLink);
+        g_queue_push_head_link(&m_lIconCacheLru, pLink);
+
+        return pLink->data;
+    }
+
+    GIcon *pIcon = g_icon_deserialize(pVariant);
+
+    if (!pIcon)
+    {
+        return NULL;
+    }
+
+    IndicatorNgIconCacheEntry *pEntry = g_slice_new0(IndicatorNgIconCacheEntry);
+    pEntry->pVariant = g_variant_ref_sink(pVariant);
+    pEntry->pIcon = pIcon;
+    g_queue_push_head(&m_lIconCacheLru, pEntry);
+    g_hash_table_insert(m_pIconCache, pEntry->pVariant, m_lIconCacheLru.head);
+
+    if (m_lIconCacheLru.length > ICON_CACHE_SIZE)
+    {
+        IndicatorNgIconCacheEntry *pOldest = g_queue_pop_tail(&m_lIconCacheLru);
+        g_hash_table_remove(m_pIconCache, pOldest->pVariant);
+        indicator_ng_icon_cache_entry_free(pOldest);
+    }
+
+    return pEntry;
 }
 
 static void
 indicator_ng_set_icon_from_variant (IndicatorNg *self,
                                     GVariant    *variant)
 {
-  GIcon *icon;
+  IndicatorNgIconCacheEntry *cached;
+  gboolean hit;
+
+  g_clear_object (&self->icon);
 
   if (variant == NULL)
     {
@@ -528,13 +1564,30 @@ indicator_ng_set_icon_from_variant (IndicatorNg *self,
       return;
     }
 
+  cached = indicator_ng_icon_cache_lookup (variant, &hit);
+  if (hit)
+    self->icon_cache_hits++;
+  else
+    self->icon_reloads++;
+  if (cached)
+    self->icon = g_object_ref (cached->pIcon);
+
+  if (self->entry.image == NULL)
+    {
+      if (cached == NULL)
+        {
+          gchar *text = g_variant_print (variant, TRUE);
+          g_warning ("invalid icon variant '%s'", text);
+          g_free (text);
+        }
+      return;
+    }
+
   gtk_widget_show (GTK_WIDGET (self->entry.image));
 
-  icon = g_icon_deserialize (variant);
-  if (icon)
+  if (cached)
     {
-      indicator_image_helper_update_from_gicon (self->entry.image, icon);
-      g_object_unref (icon);
+      indicator_image_helper_update_from_gicon (self->entry.image, cached->pIcon);
     }
   else
     {
@@ -554,23 +1607,21 @@ static void indicator_ng_set_label(IndicatorNg *self, const gchar *label)
 
     const gchar *sLabel = label;
     guint nSpacing = 3;
-    guint nPadding = 6;
+    gboolean bPadded = TRUE;
 
     if (label == NULL || *label == '\0' || !self->entry.image || !gtk_widget_get_visible(GTK_WIDGET(self->entry.image)))
     {
         nSpacing = 0;
-        nPadding = 0;
+        bPadded = FALSE;
     }
 
     GtkWidget *pParent = gtk_widget_get_parent(GTK_WIDGET(self->entry.label));
-    if (self->label_css_provider == NULL) {
-        self->label_css_provider = gtk_css_provider_new();
-        GtkStyleContext *pStyleContext = gtk_widget_get_style_context(GTK_WIDGET(self->entry.label));
-        gtk_style_context_add_provider(pStyleContext, GTK_STYLE_PROVIDER(self->label_css_provider), GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-    }
-    gchar *sCss = g_strdup_printf("label{padding-left: %ipx;}", nPadding);
-    gtk_css_provider_load_from_data(self->label_css_provider, sCss, -1, NULL);
-    g_free(sCss);
+    GtkStyleContext *pStyleContext = gtk_widget_get_style_context(GTK_WIDGET(self->entry.label));
+
+    // Both states are precompiled in the shared provider, so this only toggles classes (a no-op when unchanged)
+    gtk_style_context_remove_class(pStyleContext, bPadded ? LABEL_CLASS_UNPADDED : LABEL_CLASS_PADDED);
+    gtk_style_context_add_class(pStyleContext, bPadded ? LABEL_CLASS_PADDED : LABEL_CLASS_UNPADDED);
+
     if (GTK_IS_BOX(pParent))
     {
         gtk_box_set_spacing(GTK_BOX(pParent), nSpacing);
@@ -583,14 +1634,28 @@ static void indicator_ng_set_label(IndicatorNg *self, const gchar *label)
     }
 }
 
+static gboolean
+indicator_ng_variant_equal0 (GVariant *a,
+                             GVariant *b)
+{
+  if (a == NULL || b == NULL)
+    return a == b;
+
+  return g_variant_equal (a, b);
+}
+
+/* Only pushes the parts of the header that differ from the last applied
+ * state into the widgets, so that e.g. a ticking clock label doesn't
+ * reload the icon or emit accessible-desc-update every time. */
 static void
 indicator_ng_update_entry (IndicatorNg *self)
 {
   GVariant *state;
-  const gchar *label = NULL;
-  GVariant *icon = NULL;
-  const gchar *accessible_desc = NULL;
-  gboolean visible = TRUE;
+  IndicatorNgHeader header = { NULL, NULL, NULL, NULL, TRUE };
+  gboolean icon_changed;
+  gboolean label_changed;
+  INDICATOR_TRACE_SCOPE ("update-entry", self->name);
+  INDICATOR_NG_TIME_HANDLER (self, HANDLER_UPDATE_ENTRY);
 
   g_return_if_fail (self->menu != NULL);
   g_return_if_fail (self->actions != NULL);
@@ -607,38 +1672,198 @@ indicator_ng_update_entry (IndicatorNg *self)
     {
       const gchar *iconstr = NULL;
 
-      g_variant_get (state, "(&s&s&sb)", &label, &iconstr, &accessible_desc, &visible);
+      g_variant_get (state, "(s&ssb)", &header.label, &iconstr, &header.accessible_desc, &header.visible);
 
       if (iconstr)
-        icon = g_variant_ref_sink (g_variant_new_string (iconstr));
+        header.icon = g_variant_ref_sink (g_variant_new_string (iconstr));
     }
   else if (state && g_variant_is_of_type (state, G_VARIANT_TYPE ("a{sv}")))
     {
-      g_variant_lookup (state, "label", "&s", &label);
-      g_variant_lookup (state, "icon", "*", &icon);
-      g_variant_lookup (state, "accessible-desc", "&s", &accessible_desc);
-      g_variant_lookup (state, "visible", "b", &visible);
-      g_variant_lookup (state, "tooltip", "&s", &self->sTooltip);
+      g_variant_lookup (state, "label", "s", &header.label);
+      g_variant_lookup (state, "icon", "*", &header.icon);
+      g_variant_lookup (state, "accessible-desc", "s", &header.accessible_desc);
+      g_variant_lookup (state, "visible", "b", &header.visible);
+      g_variant_lookup (state, "tooltip", "s", &header.tooltip);
     }
   else
     g_warning ("the action of the indicator menu item must have state with type (sssb) or a{sv}");
 
-  indicator_ng_set_label (self, label);
-  indicator_ng_set_icon_from_variant (self, icon);
-  indicator_ng_set_accessible_desc (self, accessible_desc);
-  indicator_ng_set_tooltip (self, self->bMenuShown ? NULL : self->sTooltip);
-  indicator_object_set_visible (INDICATOR_OBJECT (self), visible);
+  /* the label's padding depends on whether the icon is shown, so the
+   * icon has to be applied first */
+  icon_changed = !self->header_valid || !indicator_ng_variant_equal0 (header.icon, self->header.icon);
+  if (icon_changed)
+    indicator_ng_set_icon_from_variant (self, header.icon);
+
+  label_changed = !self->header_valid || g_strcmp0 (header.label, self->header.label) != 0;
+  if (icon_changed || label_changed)
+    indicator_ng_set_label (self, header.label);
+
+  if (!self->header_valid || g_strcmp0 (header.accessible_desc, self->header.accessible_desc) != 0)
+    indicator_ng_set_accessible_desc (self, header.accessible_desc);
+
+  if (!self->header_valid || g_strcmp0 (header.tooltip, self->header.tooltip) != 0)
+    indicator_ng_set_tooltip (self, self->bMenuShown ? NULL : header.tooltip);
+
+  indicator_ng_header_clear (&self->header);
+  self->header = header;
+  self->header_valid = TRUE;
+  self->header_updates++;
+
+  if (icon_changed)
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_ICON]);
+  if (label_changed)
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_LABEL]);
+
+  if (header.visible != indicator_object_entry_is_visible (INDICATOR_OBJECT (self), &self->entry))
+    indicator_object_set_visible (INDICATOR_OBJECT (self), header.visible);
 
-  if (icon)
-    g_variant_unref (icon);
   if (state)
     g_variant_unref (state);
 }
 
+static void
+indicator_ng_flush_queued_update (IndicatorNg *self)
+{
+  /* the service might have vanished since the update was queued */
+  if (self->menu && self->actions)
+    indicator_ng_update_entry (self);
+}
+
 static gboolean
-indicator_ng_menu_item_is_of_type (GMenuModel  *menu,
-                                   gint         index,
-                                   const gchar *expected_type)
+indicator_ng_update_tick (__attribute__((unused)) GtkWidget     *widget,
+                          __attribute__((unused)) GdkFrameClock *frame_clock,
+                          gpointer                               user_data)
+{
+  IndicatorNg *self = user_data;
+
+  self->update_tick_id = 0;
+  self->update_tick_widget = NULL;
+  indicator_ng_flush_queued_update (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+indicator_ng_update_idle (gpointer user_data)
+{
+  IndicatorNg *self = user_data;
+
+  self->update_idle_id = 0;
+  indicator_ng_flush_queued_update (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Tick callbacks stop firing once their widget is unrealized (e.g.
+ * when the host removes the entry), so move a pending update to the
+ * main loop instead of losing it. */
+static void
+indicator_ng_header_unrealized (GtkWidget *widget,
+                                gpointer   user_data)
+{
+  IndicatorNg *self = user_data;
+
+  if (self->update_tick_id && self->update_tick_widget == widget)
+    {
+      indicator_ng_cancel_queued_update (self);
+      self->update_idle_id = g_idle_add (indicator_ng_update_idle, self);
+    }
+
+  if (self->scroll_tick_id && self->scroll_tick_widget == widget)
+    {
+      indicator_ng_cancel_queued_scroll (self);
+      self->scroll_idle_id = g_idle_add (indicator_ng_scroll_idle, self);
+    }
+}
+
+/* Applies the header state right away, or, when coalescing is enabled,
+ * marks it dirty and applies it once on the next frame clock tick of
+ * the header widgets. Any further change arriving before that tick is
+ * merged into the pending update. */
+static void
+indicator_ng_dispatch_update_entry (IndicatorNg *self)
+{
+  GtkWidget *widget = NULL;
+
+  if (!self->coalesce_updates)
+    {
+      indicator_ng_update_entry (self);
+      return;
+    }
+
+  if (self->update_tick_id || self->update_idle_id)
+    {
+      self->merged_updates++;
+      g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MERGED_UPDATES]);
+      return;
+    }
+
+  if (self->entry.image && gtk_widget_get_realized (GTK_WIDGET (self->entry.image)))
+    widget = GTK_WIDGET (self->entry.image);
+  else if (self->entry.label && gtk_widget_get_realized (GTK_WIDGET (self->entry.label)))
+    widget = GTK_WIDGET (self->entry.label);
+
+  /* without a frame clock (not on screen yet), wait for the main loop */
+  if (widget)
+    {
+      self->update_tick_widget = widget;
+      self->update_tick_id = gtk_widget_add_tick_callback (widget, indicator_ng_update_tick, self, NULL);
+    }
+  else
+    {
+      self->update_idle_id = g_idle_add (indicator_ng_update_idle, self);
+    }
+}
+
+static gboolean
+indicator_ng_rate_limit_expired (gpointer user_data)
+{
+  IndicatorNg *self = user_data;
+
+  self->rate_limit_id = 0;
+  self->last_update_time = g_get_monotonic_time ();
+  indicator_ng_dispatch_update_entry (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Entry point for header state changes. With a maximum update rate,
+ * a change arriving too soon after the previous update is deferred to
+ * the end of the interval, and any further change until then is
+ * dropped in its favour: the state applied at the end is always the
+ * latest one. */
+static void
+indicator_ng_queue_update_entry (IndicatorNg *self)
+{
+  if (self->max_update_rate)
+    {
+      gint64 interval = G_USEC_PER_SEC / self->max_update_rate;
+      gint64 elapsed = g_get_monotonic_time () - self->last_update_time;
+
+      if (self->rate_limit_id)
+        {
+          self->dropped_updates++;
+          g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_DROPPED_UPDATES]);
+          return;
+        }
+
+      if (elapsed < interval)
+        {
+          self->rate_limit_id = g_timeout_add ((interval - elapsed + 999) / 1000,
+                                               indicator_ng_rate_limit_expired, self);
+          return;
+        }
+
+      self->last_update_time += elapsed;
+    }
+
+  indicator_ng_dispatch_update_entry (self);
+}
+
+static gboolean
+indicator_ng_menu_item_is_of_type (GMenuModel  *menu,
+                                   gint         index,
+                                   const gchar *expected_type)
 {
   gchar *type;
   gboolean has_type = FALSE;
@@ -652,6 +1877,21 @@ indicator_ng_menu_item_is_of_type (GMenuModel  *menu,
   return has_type;
 }
 
+/* Binds the popup linked from the root item to the menu, which makes
+ * the menu model subscribe to it and build its widgets */
+static void
+indicator_ng_bind_popup (IndicatorNg *self)
+{
+  g_clear_pointer (&self->pMenuSections, indicator_ng_menu_section_free);
+
+  if (self->popup && self->entry.menu)
+    {
+      gtk_menu_shell_bind_model (GTK_MENU_SHELL (self->entry.menu), self->popup, NULL, TRUE);
+      self->menu_rebuilds++;
+      indicator_ng_prewarm_schedule (self);
+    }
+}
+
 static void
 indicator_ng_menu_changed (__attribute__((unused)) GMenuModel *menu,
                            gint        position,
@@ -660,6 +1900,8 @@ indicator_ng_menu_changed (__attribute__((unused)) GMenuModel *menu,
                            gpointer    user_data)
 {
   IndicatorNg *self = user_data;
+  INDICATOR_TRACE_SCOPE ("menu-changed", self->name);
+  INDICATOR_NG_TIME_HANDLER (self, HANDLER_MENU_CHANGED);
 
   /* The menu may only contain one item (the indicator title menu).
    * Thus, the position is always 0, and there is either exactly one
@@ -669,7 +1911,15 @@ indicator_ng_menu_changed (__attribute__((unused)) GMenuModel *menu,
   g_return_if_fail (added < 2 && removed < 2 && added ^ removed);
 
   if (removed)
-    indicator_object_set_visible (INDICATOR_OBJECT (self), FALSE);
+    {
+      indicator_object_set_visible (INDICATOR_OBJECT (self), FALSE);
+
+      if (self->popup)
+        {
+          g_clear_object (&self->popup);
+          g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MENU_MODEL]);
+        }
+    }
 
   if (added)
     {
@@ -679,7 +1929,6 @@ indicator_ng_menu_changed (__attribute__((unused)) GMenuModel *menu,
 
       if (indicator_ng_menu_item_is_of_type (self->menu, 0, "org.ayatana.indicator.root"))
         {
-          GMenuModel *popup;
           gchar *action;
 
           if (g_menu_model_get_item_attribute (self->menu, 0, G_MENU_ATTRIBUTE_ACTION, "s", &action))
@@ -710,20 +1959,12 @@ indicator_ng_menu_changed (__attribute__((unused)) GMenuModel *menu,
               g_free (action);
             }
 
-            for (guint nMenuSection = 0; nMenuSection < MENU_SECTIONS; nMenuSection++)
-            {
-                if (self->lMenuSections[nMenuSection])
-                {
-                    g_object_unref(self->lMenuSections[nMenuSection]);
-                }
-            }
+          g_clear_object (&self->popup);
+          self->popup = g_menu_model_get_item_link (self->menu, 0, G_MENU_LINK_SUBMENU);
+          g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MENU_MODEL]);
 
-          popup = g_menu_model_get_item_link (self->menu, 0, G_MENU_LINK_SUBMENU);
-          if (popup)
-            {
-              gtk_menu_shell_bind_model (GTK_MENU_SHELL (self->entry.menu), popup, NULL, TRUE);
-              g_object_unref (popup);
-            }
+          if (!self->lazy_menu || self->menu_requested)
+            indicator_ng_bind_popup (self);
 
           indicator_ng_update_entry (self);
         }
@@ -732,6 +1973,78 @@ indicator_ng_menu_changed (__attribute__((unused)) GMenuModel *menu,
     }
 }
 
+/* Binds the popup now if it was held back by #IndicatorNg:lazy-menu */
+static void
+indicator_ng_request_menu (IndicatorNg *self)
+{
+  if (!self->lazy_menu || self->menu_requested)
+    return;
+
+  self->menu_requested = TRUE;
+
+  if (self->popup)
+    indicator_ng_bind_popup (self);
+}
+
+static void
+indicator_ng_entry_pointer_enter (IndicatorObject                       *io,
+                                  __attribute__((unused)) IndicatorObjectEntry *entry)
+{
+  indicator_ng_request_menu (INDICATOR_NG (io));
+}
+
+static void
+indicator_ng_entry_activate (IndicatorObject                       *io,
+                             __attribute__((unused)) IndicatorObjectEntry *entry,
+                             __attribute__((unused)) guint                 timestamp)
+{
+  indicator_ng_request_menu (INDICATOR_NG (io));
+}
+
+static void
+indicator_ng_shared_proxy_finalized (gpointer  data,
+                                     __attribute__((unused)) GObject  *where_the_object_was)
+{
+  g_hash_table_remove (m_pSharedProxies, data);
+}
+
+/* Returns a new reference to the action group (or menu model) that
+ * @name_owner exports at @object_path on @connection. All indicators
+ * of a service share these, so that the service sees one subscription
+ * per object instead of one per profile. */
+static gpointer
+indicator_ng_get_shared_proxy (GDBusConnection *connection,
+                               const gchar     *name_owner,
+                               const gchar     *object_path,
+                               gboolean         menu)
+{
+  gchar *key;
+  GObject *proxy;
+
+  if (m_pSharedProxies == NULL)
+    m_pSharedProxies = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  /* the proxies keep the connection alive, so its address stays unique */
+  key = g_strdup_printf ("%c %p %s %s", menu ? 'm' : 'a', (gpointer) connection, name_owner, object_path);
+
+  proxy = g_hash_table_lookup (m_pSharedProxies, key);
+  if (proxy)
+    {
+      g_free (key);
+      return g_object_ref (proxy);
+    }
+
+  if (menu)
+    proxy = G_OBJECT (g_dbus_menu_model_get (connection, name_owner, object_path));
+  else
+    proxy = G_OBJECT (g_dbus_action_group_get (connection, name_owner, object_path));
+
+  g_hash_table_insert (m_pSharedProxies, key, proxy);
+  g_object_weak_ref (proxy, indicator_ng_shared_proxy_finalized, key);
+
+  return proxy;
+}
+
 static void
 indicator_ng_service_appeared (GDBusConnection *connection,
                                __attribute__((unused)) const gchar     *name,
@@ -739,6 +2052,8 @@ indicator_ng_service_appeared (GDBusConnection *connection,
                                gpointer         user_data)
 {
   IndicatorNg *self = user_data;
+  INDICATOR_TRACE_SCOPE ("service-appeared", self->name);
+  INDICATOR_NG_TIME_HANDLER (self, HANDLER_SERVICE_APPEARED);
 
   g_assert (!self->actions);
   g_assert (!self->menu);
@@ -746,15 +2061,18 @@ indicator_ng_service_appeared (GDBusConnection *connection,
   /* watch is not established when menu_object_path == NULL */
   g_assert (self->menu_object_path);
 
-  self->session_bus = g_object_ref (connection);
+  g_free (self->name_owner);
+  self->name_owner = g_strdup (name_owner);
+  self->scroll_cancellable = g_cancellable_new ();
 
-  self->actions = G_ACTION_GROUP (g_dbus_action_group_get (connection, name_owner, self->object_path));
-  gtk_widget_insert_action_group (GTK_WIDGET (self->entry.menu), "indicator", self->actions);
-  g_signal_connect_swapped (self->actions, "action-added", G_CALLBACK (indicator_ng_update_entry), self);
-  g_signal_connect_swapped (self->actions, "action-removed", G_CALLBACK (indicator_ng_update_entry), self);
-  g_signal_connect_swapped (self->actions, "action-state-changed", G_CALLBACK (indicator_ng_update_entry), self);
+  self->actions = G_ACTION_GROUP (indicator_ng_get_shared_proxy (connection, name_owner, self->object_path, FALSE));
+  if (self->entry.menu)
+    gtk_widget_insert_action_group (GTK_WIDGET (self->entry.menu), "indicator", self->actions);
+  g_signal_connect_swapped (self->actions, "action-added", G_CALLBACK (indicator_ng_queue_update_entry), self);
+  g_signal_connect_swapped (self->actions, "action-removed", G_CALLBACK (indicator_ng_queue_update_entry), self);
+  g_signal_connect_swapped (self->actions, "action-state-changed", G_CALLBACK (indicator_ng_queue_update_entry), self);
 
-  self->menu = G_MENU_MODEL (g_dbus_menu_model_get (connection, name_owner, self->menu_object_path));
+  self->menu = G_MENU_MODEL (indicator_ng_get_shared_proxy (connection, name_owner, self->menu_object_path, TRUE));
   g_signal_connect (self->menu, "items-changed", G_CALLBACK (indicator_ng_menu_changed), self);
   if (g_menu_model_get_n_items (self->menu))
     indicator_ng_menu_changed (self->menu, 0, 0, 1, self);
@@ -762,21 +2080,45 @@ indicator_ng_service_appeared (GDBusConnection *connection,
   indicator_ng_update_entry (self);
 }
 
+/* The restart state belongs to the service, so all of its indicators
+ * show it */
+static void
+indicator_ng_name_watch_notify (IndicatorNgNameWatch *watch,
+                                GParamSpec           *pspec)
+{
+  GSList *watchers;
+  GSList *it;
+
+  watchers = g_slist_copy_deep (watch->watchers, (GCopyFunc) g_object_ref, NULL);
+  for (it = watchers; it; it = it->next)
+    g_object_notify_by_pspec (it->data, pspec);
+  g_slist_free_full (watchers, g_object_unref);
+}
+
 static void
 indicator_ng_service_started (GObject      *source_object,
                               GAsyncResult *res,
                               gpointer      user_data)
 {
-  IndicatorNg *self = user_data;
+  IndicatorNgNameWatch *watch = user_data;
   GError *error = NULL;
   GVariant *result;
   guint32 start_service_reply;
+  GSList *it;
 
   result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), res, &error);
   if (!result)
     {
-      g_warning ("Could not activate service '%s': %s", self->name, error->message);
-      indicator_object_set_visible (INDICATOR_OBJECT (self), FALSE);
+      /* the watch is gone, along with all of its indicators */
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_error_free (error);
+          return;
+        }
+
+      g_warning ("Could not activate service '%s': %s", watch->name, error->message);
+      for (it = watch->watchers; it; it = it->next)
+        indicator_object_set_visible (INDICATOR_OBJECT (it->data), FALSE);
       g_error_free (error);
       return;
     }
@@ -790,7 +2132,7 @@ indicator_ng_service_started (GObject      *source_object,
       break;
 
     case 2: /* DBUS_START_REPLY_ALREADY_RUNNING */
-      g_warning ("could not start service '%s': it is already running", self->name);
+      g_warning ("could not start service '%s': it is already running", watch->name);
       break;
 
     default:
@@ -800,47 +2142,110 @@ indicator_ng_service_started (GObject      *source_object,
   g_variant_unref (result);
 }
 
-static void
-indicator_ng_service_vanished (__attribute__((unused)) GDBusConnection *connection,
-                               __attribute__((unused)) const gchar     *name,
-                               gpointer         user_data)
+static gboolean
+indicator_ng_restart_service (gpointer user_data)
 {
-  IndicatorNg *self = user_data;
+  IndicatorNgNameWatch *watch = user_data;
+  gint64 now;
+
+  watch->restart_id = 0;
+
+  /* this is the single retry after the cooldown */
+  if (watch->restart_state == RESTART_OPEN)
+    watch->restart_state = RESTART_HALF_OPEN;
+
+  now = g_get_monotonic_time ();
+  g_array_append_val (watch->restart_times, now);
+  watch->restart_count++;
+  watch->last_restart_time = g_get_real_time ();
+
+  /* restart_times always grows here, nothing to compare */
+  indicator_ng_name_watch_notify (watch, properties[PROP_RESTART_COUNT]);
+  indicator_ng_name_watch_notify (watch, properties[PROP_RECENT_RESTARTS]);
+
+  g_dbus_connection_call (watch->connection,
+                          "org.freedesktop.DBus",
+                          "/",
+                          "org.freedesktop.DBus",
+                          "StartServiceByName",
+                          g_variant_new ("(su)", watch->name, 0),
+                          G_VARIANT_TYPE ("(u)"),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          watch->restart_cancellable,
+                          indicator_ng_service_started,
+                          watch);
+
+  return G_SOURCE_REMOVE;
+}
 
-  indicator_ng_free_actions_and_menu (self);
+/* Schedules the restart of a crashed service. Restarts are delayed by
+ * an exponentially growing backoff with jitter. When more than
+ * RESTART_BUDGET restarts happen within RESTART_WINDOW seconds, the
+ * service is left alone for RESTART_COOLDOWN seconds and then tried once
+ * more. Running for RESTART_STABLE seconds resets all of this. */
+static void
+indicator_ng_schedule_restart (IndicatorNgNameWatch *watch)
+{
+  gint64 now = g_get_monotonic_time ();
+  guint recent_restarts = watch->restart_times->len;
+  guint restart_backoff = watch->restart_backoff;
+  guint expired = 0;
+  guint delay;
 
-  /* Names may vanish because the service decided it doesn't need to
-   * show its indicator anymore, or because it crashed.  Let's assume it
-   * crashes and restart it unless it explicitly hid its indicator. */
+  if (watch->restart_id)
+    return;
 
-  if (indicator_object_entry_is_visible (INDICATOR_OBJECT (self), &self->entry))
+  if (now - watch->service_appeared_time >= RESTART_STABLE * G_USEC_PER_SEC)
     {
-      gint64 now;
+      watch->restart_state = RESTART_CLOSED;
+      watch->restart_backoff = watch->restart_backoff_initial;
+      g_array_set_size (watch->restart_times, 0);
+    }
 
-      /* take care not to start it if it repeatedly crashes */
-      now = g_get_monotonic_time ();
-      if (now - self->last_service_restart < 1 * G_USEC_PER_SEC)
-        {
-          g_warning ("The indicator '%s' vanished too quickly after appearing. It won't "
-                     "be respawned anymore, as it could be crashing repeatedly.", self->name);
-          return;
-        }
+  /* forget restarts that dropped out of the window */
+  while (expired < watch->restart_times->len &&
+         now - g_array_index (watch->restart_times, gint64, expired) > RESTART_WINDOW * G_USEC_PER_SEC)
+    expired++;
+  g_array_remove_range (watch->restart_times, 0, expired);
 
-      self->last_service_restart = now;
+  if (watch->restart_state == RESTART_HALF_OPEN ||
+      watch->restart_times->len >= RESTART_BUDGET)
+    {
+      if (watch->restart_state != RESTART_HALF_OPEN)
+        g_warning ("The indicator '%s' vanished %u times within %u seconds. It won't be "
+                   "respawned for %u seconds, as it could be crashing repeatedly.",
+                   watch->name, RESTART_BUDGET, RESTART_WINDOW, watch->restart_cooldown);
 
-      g_dbus_connection_call (self->session_bus,
-                              "org.freedesktop.DBus",
-                              "/",
-                              "org.freedesktop.DBus",
-                              "StartServiceByName",
-                              g_variant_new ("(su)", self->bus_name, 0),
-                              G_VARIANT_TYPE ("(u)"),
-                              G_DBUS_CALL_FLAGS_NONE,
-                              -1,
-                              NULL,
-                              indicator_ng_service_started,
-                              self);
+      watch->restart_state = RESTART_OPEN;
+      watch->restart_id = g_timeout_add_seconds (watch->restart_cooldown, indicator_ng_restart_service, watch);
+    }
+  else
+    {
+      /* somewhere between half and all of the backoff */
+      delay = watch->restart_backoff / 2 + g_random_int_range (0, watch->restart_backoff / 2 + 1);
+      watch->restart_backoff = MIN (watch->restart_backoff * 2, RESTART_BACKOFF_MAX);
+      watch->restart_id = g_timeout_add (delay, indicator_ng_restart_service, watch);
     }
+
+  if (watch->restart_times->len != recent_restarts)
+    indicator_ng_name_watch_notify (watch, properties[PROP_RECENT_RESTARTS]);
+  if (watch->restart_backoff != restart_backoff)
+    indicator_ng_name_watch_notify (watch, properties[PROP_RESTART_BACKOFF]);
+}
+
+/* Drops what the indicator got from the service. Returns whether the
+ * service should be restarted for it.
+ *
+ * Names may vanish because the service decided it doesn't need to show
+ * its indicator anymore, or because it crashed.  Let's assume it crashes
+ * and restart it unless it explicitly hid its indicator. */
+static gboolean
+indicator_ng_service_vanished (IndicatorNg *self)
+{
+  indicator_ng_free_actions_and_menu (self);
+
+  return indicator_object_entry_is_visible (INDICATOR_OBJECT (self), &self->entry);
 }
 
 /* Get an integer from a keyfile. Returns @default_value if the key
@@ -883,6 +2288,10 @@ indicator_ng_load_from_keyfile (IndicatorNg  *self,
 
   self->position = g_key_file_maybe_get_integer (keyfile, "Indicator Service", "Position", -1);
 
+  /* the host's choice wins over the service's */
+  if (!self->max_update_rate_set)
+    self->max_update_rate = MAX (g_key_file_maybe_get_integer (keyfile, "Indicator Service", "MaxUpdateRate", 0), 0);
+
   /*
    * Don't throw an error when the profile doesn't exist. Non-existant
    * profiles are silently ignored by not showing an indicator at all.
@@ -901,39 +2310,336 @@ indicator_ng_load_from_keyfile (IndicatorNg  *self,
   return TRUE;
 }
 
+/* Reads the service file into @self. This doesn't touch anything but
+ * @self's own strings, so it is safe to call from a worker thread while
+ * the object isn't handed out yet. */
 static gboolean
-indicator_ng_initable_init (GInitable     *initable,
-                            __attribute__((unused)) GCancellable  *cancellable,
-                            GError       **error)
+indicator_ng_load_service_file (IndicatorNg  *self,
+                                GError      **error)
 {
-  IndicatorNg *self = INDICATOR_NG (initable);
   GKeyFile *keyfile;
-  gboolean success = FALSE;
-
-  self->bus_name = g_path_get_basename (self->service_file);
+  gboolean success;
 
   keyfile = g_key_file_new ();
-  if (g_key_file_load_from_file (keyfile, self->service_file, G_KEY_FILE_NONE, error) &&
-      indicator_ng_load_from_keyfile (self, keyfile, error))
+  success = g_key_file_load_from_file (keyfile, self->service_file, G_KEY_FILE_NONE, error) &&
+            indicator_ng_load_from_keyfile (self, keyfile, error);
+
+  g_key_file_free (keyfile);
+  return success;
+}
+
+static void
+indicator_ng_name_watch_appeared (GDBusConnection *connection,
+                                  const gchar     *name,
+                                  const gchar     *name_owner,
+                                  gpointer         user_data)
+{
+  IndicatorNgNameWatch *watch = user_data;
+  GSList *watchers;
+  GSList *it;
+
+  watch->known = TRUE;
+  g_free (watch->name_owner);
+  watch->name_owner = g_strdup (name_owner);
+
+  /* it came back on its own, e.g. activated by someone else */
+  if (watch->restart_id)
     {
-      self->entry.name_hint = self->name;
+      g_source_remove (watch->restart_id);
+      watch->restart_id = 0;
+    }
+
+  watch->service_appeared_time = g_get_monotonic_time ();
 
-      /* only watch the service when it supports the proile we're interested in */
-      if (self->menu_object_path)
+  /* the watchers may go away while being told */
+  watchers = g_slist_copy_deep (watch->watchers, (GCopyFunc) g_object_ref, NULL);
+  for (it = watchers; it; it = it->next)
+    {
+      IndicatorNg *self = it->data;
+
+      if (self->name_watch_replay_id)
         {
-          self->name_watch_id = g_bus_watch_name (G_BUS_TYPE_SESSION,
-                                                  self->bus_name,
-                                                  G_BUS_NAME_WATCHER_FLAGS_AUTO_START,
-                                                  indicator_ng_service_appeared,
-                                                  indicator_ng_service_vanished,
-                                                  self, NULL);
+          g_source_remove (self->name_watch_replay_id);
+          self->name_watch_replay_id = 0;
         }
 
-      success = TRUE;
+      if (self->name_watch == watch && !self->actions)
+        indicator_ng_service_appeared (connection, name, name_owner, self);
     }
+  g_slist_free_full (watchers, g_object_unref);
+}
 
-  g_key_file_free (keyfile);
-  return success;
+static void
+indicator_ng_name_watch_vanished (__attribute__((unused)) GDBusConnection *connection,
+                                  __attribute__((unused)) const gchar     *name,
+                                  gpointer         user_data)
+{
+  IndicatorNgNameWatch *watch = user_data;
+  GSList *watchers;
+  GSList *it;
+  gboolean restart = FALSE;
+
+  watch->known = TRUE;
+  g_clear_pointer (&watch->name_owner, g_free);
+
+  watchers = g_slist_copy_deep (watch->watchers, (GCopyFunc) g_object_ref, NULL);
+  for (it = watchers; it; it = it->next)
+    {
+      IndicatorNg *self = it->data;
+
+      if (self->name_watch_replay_id)
+        {
+          g_source_remove (self->name_watch_replay_id);
+          self->name_watch_replay_id = 0;
+        }
+
+      if (self->name_watch == watch)
+        restart |= indicator_ng_service_vanished (self);
+    }
+
+  /* one restart for all of them */
+  if (restart)
+    indicator_ng_schedule_restart (watch);
+  g_slist_free_full (watchers, g_object_unref);
+}
+
+/* Tells an indicator that joined an existing watch what the others
+ * already know, from the main loop like g_bus_watch_name() would */
+static gboolean
+indicator_ng_name_watch_replay (gpointer user_data)
+{
+  IndicatorNg *self = user_data;
+  IndicatorNgNameWatch *watch = self->name_watch;
+
+  self->name_watch_replay_id = 0;
+
+  if (watch->name_owner)
+    indicator_ng_service_appeared (watch->connection, watch->name, watch->name_owner, self);
+  else if (indicator_ng_service_vanished (self))
+    indicator_ng_schedule_restart (watch);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+indicator_ng_watch_service (IndicatorNg *self)
+{
+  IndicatorNgNameWatch *watch;
+  gchar *key;
+
+  self->entry.name_hint = self->name;
+
+  /* the image helper only gets the widget */
+  if (self->entry.image)
+    INDICATOR_TRACE_SET_NAME (self->entry.image, self->name);
+
+  /* only watch the service when it supports the proile we're interested in */
+  if (!self->menu_object_path || !self->connection)
+    return;
+
+  if (m_pNameWatches == NULL)
+    m_pNameWatches = g_hash_table_new (g_str_hash, g_str_equal);
+
+  /* the watch keeps the connection alive, so its address stays unique */
+  key = g_strdup_printf ("%p %s", (gpointer) self->connection, self->bus_name);
+  watch = g_hash_table_lookup (m_pNameWatches, key);
+  if (watch == NULL)
+    {
+      watch = g_slice_new0 (IndicatorNgNameWatch);
+      watch->key = key;
+      watch->name = g_strdup (self->bus_name);
+      watch->connection = g_object_ref (self->connection);
+      g_hash_table_insert (m_pNameWatches, watch->key, watch);
+
+      watch->restart_times = g_array_new (FALSE, FALSE, sizeof (gint64));
+      watch->restart_backoff_initial = RESTART_BACKOFF_INITIAL;
+      watch->restart_cooldown = RESTART_COOLDOWN;
+      watch->restart_cancellable = g_cancellable_new ();
+
+      /* let tests go through the restart states in reasonable time */
+      {
+        const gchar *env;
+
+        env = g_getenv ("INDICATOR_NG_RESTART_BACKOFF");
+        if (env && g_ascii_strtoull (env, NULL, 10) > 0)
+          watch->restart_backoff_initial = MIN (g_ascii_strtoull (env, NULL, 10), RESTART_BACKOFF_MAX);
+
+        env = g_getenv ("INDICATOR_NG_RESTART_COOLDOWN");
+        if (env && g_ascii_strtoull (env, NULL, 10) > 0)
+          watch->restart_cooldown = MIN (g_ascii_strtoull (env, NULL, 10), RESTART_COOLDOWN);
+      }
+
+      watch->restart_backoff = watch->restart_backoff_initial;
+
+      watch->watch_id = g_bus_watch_name_on_connection (watch->connection,
+                                                        watch->name,
+                                                        G_BUS_NAME_WATCHER_FLAGS_AUTO_START,
+                                                        indicator_ng_name_watch_appeared,
+                                                        indicator_ng_name_watch_vanished,
+                                                        watch, NULL);
+    }
+  else
+    {
+      g_free (key);
+
+      if (watch->known)
+        self->name_watch_replay_id = g_idle_add (indicator_ng_name_watch_replay, self);
+    }
+
+  watch->watchers = g_slist_prepend (watch->watchers, self);
+  self->name_watch = watch;
+}
+
+static void
+indicator_ng_unwatch_service (IndicatorNg *self)
+{
+  IndicatorNgNameWatch *watch = self->name_watch;
+
+  if (watch == NULL)
+    return;
+
+  if (self->name_watch_replay_id)
+    {
+      g_source_remove (self->name_watch_replay_id);
+      self->name_watch_replay_id = 0;
+    }
+
+  self->name_watch = NULL;
+  watch->watchers = g_slist_remove (watch->watchers, self);
+
+  if (watch->watchers == NULL)
+    {
+      g_hash_table_remove (m_pNameWatches, watch->key);
+      g_bus_unwatch_name (watch->watch_id);
+      if (watch->restart_id)
+        g_source_remove (watch->restart_id);
+      g_cancellable_cancel (watch->restart_cancellable);
+      g_object_unref (watch->restart_cancellable);
+      g_array_unref (watch->restart_times);
+      g_clear_object (&watch->connection);
+      g_free (watch->name_owner);
+      g_free (watch->name);
+      g_free (watch->key);
+      g_slice_free (IndicatorNgNameWatch, watch);
+    }
+}
+
+/* Connects to the session bus unless a connection was given. Only
+ * indicators for a profile the service supports talk to it. This may
+ * block, so it runs on the worker thread of the async constructor. */
+static void
+indicator_ng_get_connection (IndicatorNg  *self,
+                             GCancellable *cancellable)
+{
+  GError *error = NULL;
+
+  if (self->connection || !self->menu_object_path)
+    return;
+
+  self->connection = g_bus_get_sync (G_BUS_TYPE_SESSION, cancellable, &error);
+  if (self->connection == NULL)
+    {
+      g_warning ("Could not connect to the session bus for '%s': %s", self->name, error->message);
+      g_error_free (error);
+    }
+}
+
+/* Takes what indicator_ng_load_service_file() would read from an
+ * index record. The record is only borrowed during construction. */
+static void
+indicator_ng_load_index_record (IndicatorNg *self)
+{
+  const IndicatorNgIndexRecord *record = self->index_record;
+
+  self->name = g_strdup (record->name);
+  self->object_path = g_strdup (record->object_path);
+  self->menu_object_path = g_strdup (record->menu_object_path);
+  self->position = record->position;
+  if (!self->max_update_rate_set)
+    self->max_update_rate = record->max_update_rate;
+
+  self->index_record = NULL;
+}
+
+static gboolean
+indicator_ng_initable_init (GInitable     *initable,
+                            GCancellable  *cancellable,
+                            GError       **error)
+{
+  IndicatorNg *self = INDICATOR_NG (initable);
+
+  self->bus_name = g_path_get_basename (self->service_file);
+
+  if (self->index_record)
+    indicator_ng_load_index_record (self);
+  else if (!indicator_ng_load_service_file (self, error))
+    return FALSE;
+
+  indicator_ng_get_connection (self, cancellable);
+  indicator_ng_watch_service (self);
+  return TRUE;
+}
+
+static void
+indicator_ng_init_thread (GTask        *task,
+                          gpointer      source_object,
+                          __attribute__((unused)) gpointer      task_data,
+                          GCancellable *cancellable)
+{
+  IndicatorNg *self = source_object;
+  GError *error = NULL;
+
+  /* the index record, if any, was taken before */
+  if (g_cancellable_set_error_if_cancelled (cancellable, &error) ||
+      (self->name == NULL && !indicator_ng_load_service_file (self, &error)))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  indicator_ng_get_connection (self, cancellable);
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+indicator_ng_init_async (GAsyncInitable      *initable,
+                         int                  io_priority,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+  IndicatorNg *self = INDICATOR_NG (initable);
+  GTask *task;
+
+  self->bus_name = g_path_get_basename (self->service_file);
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, indicator_ng_init_async);
+  g_task_set_priority (task, io_priority);
+
+  if (self->index_record)
+    indicator_ng_load_index_record (self);
+
+  g_task_run_in_thread (task, indicator_ng_init_thread);
+  g_object_unref (task);
+}
+
+static gboolean
+indicator_ng_init_finish (GAsyncInitable  *initable,
+                          GAsyncResult    *result,
+                          GError         **error)
+{
+  IndicatorNg *self = INDICATOR_NG (initable);
+
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+  if (!g_task_propagate_boolean (G_TASK (result), error))
+    return FALSE;
+
+  /* the watch dispatches to the caller's main context, so it is set up
+   * here rather than on the worker thread */
+  indicator_ng_watch_service (self);
+  return TRUE;
 }
 
 static void
@@ -944,13 +2650,20 @@ indicator_ng_class_init (IndicatorNgClass *class)
 
   object_class->get_property = indicator_ng_get_property;
   object_class->set_property = indicator_ng_set_property;
+  object_class->constructed = indicator_ng_constructed;
   object_class->dispose = indicator_ng_dispose;
   object_class->finalize = indicator_ng_finalize;
 
+  g_signal_override_class_handler (INDICATOR_OBJECT_SIGNAL_GET_STATS, INDICATOR_TYPE_NG,
+                                   G_CALLBACK (indicator_ng_get_stats));
+
   io_class->get_entries = indicator_ng_get_entries;
+  io_class->foreach_entry = indicator_ng_foreach_entry;
   io_class->get_position = indicator_ng_get_position;
   io_class->entry_scrolled = indicator_ng_entry_scrolled;
   io_class->secondary_activate = indicator_ng_secondary_activate;
+  io_class->entry_activate = indicator_ng_entry_activate;
+  io_class->entry_pointer_enter = indicator_ng_entry_pointer_enter;
 
   properties[PROP_SERVICE_FILE] = g_param_spec_string ("service-file",
                                                        "Service file",
@@ -968,6 +2681,132 @@ indicator_ng_class_init (IndicatorNgClass *class)
                                                   G_PARAM_CONSTRUCT_ONLY |
                                                   G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_LAZY_MENU] = g_param_spec_boolean ("lazy-menu",
+                                                    "Lazy menu",
+                                                    "Only fetch the popup menu when the entry is hovered or activated",
+                                                    FALSE,
+                                                    G_PARAM_READWRITE |
+                                                    G_PARAM_EXPLICIT_NOTIFY |
+                                                    G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_PREWARM_MENU] = g_param_spec_boolean ("prewarm-menu",
+                                                       "Prewarm menu",
+                                                       "Build and measure the popup menu in idle time before it is first shown",
+                                                       FALSE,
+                                                       G_PARAM_READWRITE |
+                                                       G_PARAM_EXPLICIT_NOTIFY |
+                                                       G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_COALESCE_UPDATES] = g_param_spec_boolean ("coalesce-updates",
+                                                            "Coalesce updates",
+                                                            "Apply header state changes at most once per frame",
+                                                            FALSE,
+                                                            G_PARAM_READWRITE |
+                                                            G_PARAM_EXPLICIT_NOTIFY |
+                                                            G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_MERGED_UPDATES] = g_param_spec_uint ("merged-updates",
+                                                       "Merged updates",
+                                                       "Number of header updates merged into a pending one",
+                                                       0, G_MAXUINT, 0,
+                                                       G_PARAM_READABLE |
+                                                       G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_RESTART_COUNT] = g_param_spec_uint ("restart-count",
+                                                      "Restart count",
+                                                      "Number of times the service was restarted after vanishing",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READABLE |
+                                                      G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_RECENT_RESTARTS] = g_param_spec_uint ("recent-restarts",
+                                                        "Recent restarts",
+                                                        "Number of restarts counting against the restart budget",
+                                                        0, G_MAXUINT, 0,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_RESTART_BACKOFF] = g_param_spec_uint ("restart-backoff",
+                                                        "Restart backoff",
+                                                        "Upper bound in milliseconds of the delay before the next restart",
+                                                        0, G_MAXUINT, RESTART_BACKOFF_INITIAL,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_MAX_UPDATE_RATE] = g_param_spec_uint ("max-update-rate",
+                                                        "Maximum update rate",
+                                                        "Maximum number of header updates per second, 0 for no limit",
+                                                        0, G_MAXUINT, 0,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_EXPLICIT_NOTIFY |
+                                                        G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_DROPPED_UPDATES] = g_param_spec_uint ("dropped-updates",
+                                                        "Dropped updates",
+                                                        "Number of header updates dropped by the maximum update rate",
+                                                        0, G_MAXUINT, 0,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_MAX_SCROLLS_IN_FLIGHT] = g_param_spec_uint ("max-scrolls-in-flight",
+                                                              "Maximum scrolls in flight",
+                                                              "Maximum number of unanswered scroll activations, 0 for no limit",
+                                                              0, G_MAXUINT, 0,
+                                                              G_PARAM_READWRITE |
+                                                              G_PARAM_EXPLICIT_NOTIFY |
+                                                              G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_HEADLESS] = g_param_spec_boolean ("headless",
+                                                    "Headless",
+                                                    "Only track the header state and the menu model, without creating any widgets",
+                                                    FALSE,
+                                                    G_PARAM_READWRITE |
+                                                    G_PARAM_CONSTRUCT_ONLY |
+                                                    G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_LABEL] = g_param_spec_string ("label",
+                                                "Label",
+                                                "Label of the indicator",
+                                                NULL,
+                                                G_PARAM_READABLE |
+                                                G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_ICON] = g_param_spec_object ("icon",
+                                               "Icon",
+                                               "Icon of the indicator",
+                                               G_TYPE_ICON,
+                                               G_PARAM_READABLE |
+                                               G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_ACCESSIBLE_DESC] = g_param_spec_string ("accessible-desc",
+                                                          "Accessible description",
+                                                          "Accessible description of the indicator",
+                                                          NULL,
+                                                          G_PARAM_READABLE |
+                                                          G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_MENU_MODEL] = g_param_spec_object ("menu-model",
+                                                     "Menu model",
+                                                     "Model of the indicator's popup menu",
+                                                     G_TYPE_MENU_MODEL,
+                                                     G_PARAM_READABLE |
+                                                     G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_INDEX_RECORD] = g_param_spec_pointer ("index-record",
+                                                        "Index record",
+                                                        "IndicatorNgIndexRecord to take the service file contents from",
+                                                        G_PARAM_WRITABLE |
+                                                        G_PARAM_CONSTRUCT_ONLY |
+                                                        G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_CONNECTION] = g_param_spec_object ("connection",
+                                                     "Connection",
+                                                     "Bus to find the service on, the session bus if unset",
+                                                     G_TYPE_DBUS_CONNECTION,
+                                                     G_PARAM_READWRITE |
+                                                     G_PARAM_CONSTRUCT_ONLY |
+                                                     G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties(object_class, N_PROPERTIES, properties);
 }
 
@@ -977,19 +2816,55 @@ indicator_ng_initable_iface_init (GInitableIface *initable)
   initable->init = indicator_ng_initable_init;
 }
 
+static void
+indicator_ng_async_initable_iface_init (GAsyncInitableIface *initable)
+{
+  initable->init_async = indicator_ng_init_async;
+  initable->init_finish = indicator_ng_init_finish;
+}
+
 static void
 indicator_ng_init (IndicatorNg *self)
 {
-    self->sTooltip = NULL;
     self->bMenuShown = FALSE;
     m_pActionMuxer = g_quark_from_static_string ("gtk-widget-action-muxer");
+    m_pItemSize = g_quark_from_static_string ("indicator-ng-item-size");
+    self->pMenuSections = NULL;
 
-    for (guint nMenuSection = 0; nMenuSection < MENU_SECTIONS; nMenuSection++)
+  /* work around IndicatorObject's warning that the accessible
+   * description is missing. We never set it on construction, but when
+   * the menu model has arrived on the bus.
+   */
+  self->accessible_desc = g_strdup ("");
+  self->entry.accessible_desc = self->accessible_desc;
+
+  self->position = -1;
+
+  indicator_object_set_visible (INDICATOR_OBJECT (self), FALSE);
+}
+
+static void
+indicator_ng_constructed (GObject *object)
+{
+  IndicatorNg *self = INDICATOR_NG (object);
+
+  G_OBJECT_CLASS (indicator_ng_parent_class)->constructed (object);
+
+  /* headless indicators only track the models */
+  if (self->headless)
+    return;
+
+  self->entry.label = (GtkLabel*)g_object_ref_sink (gtk_label_new (NULL));
+
+    // One provider holding both label padding states is shared by all indicators
+    if (m_pLabelCssProvider == NULL)
     {
-        self->lMenuSections[nMenuSection] = NULL;
+        m_pLabelCssProvider = gtk_css_provider_new();
+        gtk_css_provider_load_from_data(m_pLabelCssProvider, "label." LABEL_CLASS_UNPADDED "{padding-left: 0px;} label." LABEL_CLASS_PADDED "{padding-left: 6px;}", -1, NULL);
     }
 
-  self->entry.label = (GtkLabel*)g_object_ref_sink (gtk_label_new (NULL));
+    GtkStyleContext *pLabelContext = gtk_widget_get_style_context(GTK_WIDGET(self->entry.label));
+    gtk_style_context_add_provider(pLabelContext, GTK_STYLE_PROVIDER(m_pLabelCssProvider), GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
   self->entry.image = (GtkImage*)g_object_ref_sink (gtk_image_new ());
 
   self->entry.menu = (GtkMenu*)g_object_ref_sink (gtk_menu_new ());
@@ -997,6 +2872,10 @@ indicator_ng_init (IndicatorNg *self)
   g_signal_connect (self->entry.menu, "show", G_CALLBACK (indicator_ng_menu_shown), self);
   g_signal_connect (self->entry.menu, "hide", G_CALLBACK (indicator_ng_menu_hidden), self);
   g_signal_connect (self->entry.menu, "size-allocate", G_CALLBACK (indicator_ng_menu_size_allocate), self);
+  g_signal_connect_swapped (self->entry.menu, "style-updated", G_CALLBACK (indicator_ng_menu_style_changed), self);
+  g_signal_connect_swapped (self->entry.menu, "notify::border-width", G_CALLBACK (indicator_ng_menu_style_changed), self);
+  g_signal_connect (self->entry.label, "unrealize", G_CALLBACK (indicator_ng_header_unrealized), self);
+  g_signal_connect (self->entry.image, "unrealize", G_CALLBACK (indicator_ng_header_unrealized), self);
 
     GtkCssProvider *pCssProvider = gtk_css_provider_new();
     GtkStyleContext *pStyleContext = gtk_widget_get_style_context(GTK_WIDGET(self->entry.menu));
@@ -1009,17 +2888,6 @@ indicator_ng_init (IndicatorNg *self)
     gtk_css_provider_load_from_data(pCssProvider, "window > decoration {box-shadow: 0 1px 2px rgba(0,0,0,0.2), 0 0 0 1px rgba(0,0,0,0.13);}", -1, NULL);
 
     g_object_unref(pCssProvider);
-
-  /* work around IndicatorObject's warning that the accessible
-   * description is missing. We never set it on construction, but when
-   * the menu model has arrived on the bus.
-   */
-  self->accessible_desc = g_strdup ("");
-  self->entry.accessible_desc = self->accessible_desc;
-
-  self->position = -1;
-
-  indicator_object_set_visible (INDICATOR_OBJECT (self), FALSE);
 }
 
 IndicatorNg *
@@ -1042,6 +2910,104 @@ indicator_ng_new_for_profile (const gchar  *service_file,
                          NULL);
 }
 
+/**
+ * indicator_ng_new_headless:
+ * @service_file: path of the service file
+ * @profile: the profile to show, e.g. "desktop"
+ * @error: return location for a #GError
+ *
+ * Creates an indicator that doesn't create any widgets. It only follows
+ * the header state and the menu model of the service, which can be read
+ * with indicator_ng_get_label(), indicator_ng_get_icon(),
+ * indicator_ng_get_accessible_desc(), indicator_ng_get_visible() and
+ * indicator_ng_get_menu_model(). Its entry has no label, image or menu.
+ *
+ * Returns: a new #IndicatorNg, or %NULL on error
+ */
+IndicatorNg *
+indicator_ng_new_headless (const gchar  *service_file,
+                           const gchar  *profile,
+                           GError      **error)
+{
+  return g_initable_new (INDICATOR_TYPE_NG, NULL, error,
+                         "service-file", service_file,
+                         "profile", profile,
+                         "headless", TRUE,
+                         NULL);
+}
+
+/**
+ * indicator_ng_new_from_index_record:
+ * @record: a record of an #IndicatorNgIndex
+ *
+ * Creates an indicator for the service and profile described by
+ * @record, without reading the service file.
+ *
+ * Returns: (transfer full): a new #IndicatorNg
+ */
+IndicatorNg *
+indicator_ng_new_from_index_record (const IndicatorNgIndexRecord *record)
+{
+  g_return_val_if_fail (record != NULL, NULL);
+
+  return g_initable_new (INDICATOR_TYPE_NG, NULL, NULL,
+                         "service-file", record->service_file,
+                         "profile", record->profile,
+                         "index-record", record,
+                         NULL);
+}
+
+/**
+ * indicator_ng_new_for_profile_async:
+ * @service_file: the path of the service file
+ * @profile: the indicator profile
+ * @cancellable: (allow-none): a #GCancellable
+ * @callback: called when the indicator is ready
+ * @user_data: data for @callback
+ *
+ * Asynchronous version of indicator_ng_new_for_profile(). The service
+ * file is read and parsed on a worker thread, so that many indicators
+ * can be created concurrently. @callback is called in the thread-default
+ * main context of the caller, where it should call
+ * indicator_ng_new_for_profile_finish().
+ */
+void
+indicator_ng_new_for_profile_async (const gchar         *service_file,
+                                    const gchar         *profile,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
+{
+  g_async_initable_new_async (INDICATOR_TYPE_NG, G_PRIORITY_DEFAULT,
+                              cancellable, callback, user_data,
+                              "service-file", service_file,
+                              "profile", profile,
+                              NULL);
+}
+
+/**
+ * indicator_ng_new_for_profile_finish:
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError
+ *
+ * Finishes indicator_ng_new_for_profile_async().
+ *
+ * Returns: (transfer full): the new #IndicatorNg, or %NULL on error
+ */
+IndicatorNg *
+indicator_ng_new_for_profile_finish (GAsyncResult  *result,
+                                     GError       **error)
+{
+  GObject *source;
+  GObject *indicator;
+
+  source = g_async_result_get_source_object (result);
+  indicator = g_async_initable_new_finish (G_ASYNC_INITABLE (source), result, error);
+  g_object_unref (source);
+
+  return indicator ? INDICATOR_NG (indicator) : NULL;
+}
+
 const gchar *
 indicator_ng_get_service_file (IndicatorNg *self)
 {
@@ -1057,3 +3023,286 @@ indicator_ng_get_profile (IndicatorNg *self)
 
   return self->profile;
 }
+
+/**
+ * indicator_ng_set_lazy_menu:
+ * @indicator: an #IndicatorNg
+ * @lazy: whether to fetch the popup menu lazily
+ *
+ * When @lazy is %TRUE, only the root item of the service's menu is
+ * subscribed to until the entry is hovered (see
+ * indicator_object_entry_pointer_enter()), activated or its menu is
+ * shown. The popup is fetched and its widgets are built then, and kept
+ * from there on. Set this before the service appears to have an effect.
+ */
+void
+indicator_ng_set_lazy_menu (IndicatorNg *self,
+                            gboolean     lazy)
+{
+  g_return_if_fail (INDICATOR_IS_NG (self));
+
+  lazy = !!lazy;
+  if (self->lazy_menu == lazy)
+    return;
+
+  /* bind what was held back so far */
+  if (!lazy)
+    indicator_ng_request_menu (self);
+
+  self->lazy_menu = lazy;
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_LAZY_MENU]);
+}
+
+gboolean
+indicator_ng_get_lazy_menu (IndicatorNg *self)
+{
+  g_return_val_if_fail (INDICATOR_IS_NG (self), FALSE);
+
+  return self->lazy_menu;
+}
+
+/**
+ * indicator_ng_set_prewarm_menu:
+ * @indicator: an #IndicatorNg
+ * @prewarm: whether to prepare the popup menu in idle time
+ *
+ * When @prewarm is %TRUE, the popup menu is prepared for its first
+ * opening whenever its model is bound: its widgets are created, the
+ * menu is realized and its items are measured, in short slices at
+ * %G_PRIORITY_LOW. Items that arrive later are measured the same way.
+ */
+void
+indicator_ng_set_prewarm_menu (IndicatorNg *self,
+                               gboolean     prewarm)
+{
+  g_return_if_fail (INDICATOR_IS_NG (self));
+
+  prewarm = !!prewarm;
+  if (self->bPrewarmMenu == prewarm)
+    return;
+
+  self->bPrewarmMenu = prewarm;
+
+  if (prewarm)
+    indicator_ng_prewarm_schedule (self);
+  else
+    indicator_ng_prewarm_cancel (self);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PREWARM_MENU]);
+}
+
+gboolean
+indicator_ng_get_prewarm_menu (IndicatorNg *self)
+{
+  g_return_val_if_fail (INDICATOR_IS_NG (self), FALSE);
+
+  return self->bPrewarmMenu;
+}
+
+/**
+ * indicator_ng_set_coalesce_updates:
+ * @indicator: an #IndicatorNg
+ * @coalesce: whether to coalesce header updates
+ *
+ * When @coalesce is %TRUE, state changes of the header action only mark
+ * the header as dirty. It is then updated once per frame of the header
+ * widgets' #GdkFrameClock, no matter how many changes arrived in between.
+ */
+void
+indicator_ng_set_coalesce_updates (IndicatorNg *self,
+                                   gboolean     coalesce)
+{
+  g_return_if_fail (INDICATOR_IS_NG (self));
+
+  coalesce = !!coalesce;
+  if (self->coalesce_updates == coalesce)
+    return;
+
+  self->coalesce_updates = coalesce;
+
+  /* apply what's pending, as nothing would flush it otherwise */
+  if (!coalesce && indicator_ng_cancel_queued_update (self))
+    indicator_ng_flush_queued_update (self);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_COALESCE_UPDATES]);
+}
+
+gboolean
+indicator_ng_get_coalesce_updates (IndicatorNg *self)
+{
+  g_return_val_if_fail (INDICATOR_IS_NG (self), FALSE);
+
+  return self->coalesce_updates;
+}
+
+/**
+ * indicator_ng_set_max_update_rate:
+ * @indicator: an #IndicatorNg
+ * @rate: the maximum number of header updates per second, or 0
+ *
+ * Limits how often the header is updated. Changes arriving faster are
+ * dropped, except for the last one, which is applied when the interval
+ * ends. The default is taken from the "MaxUpdateRate" key of the
+ * service file's "Indicator Service" group, which this overrides.
+ */
+void
+indicator_ng_set_max_update_rate (IndicatorNg *self,
+                                  guint        rate)
+{
+  g_return_if_fail (INDICATOR_IS_NG (self));
+
+  self->max_update_rate_set = TRUE;
+
+  if (self->max_update_rate == rate)
+    return;
+
+  self->max_update_rate = rate;
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MAX_UPDATE_RATE]);
+}
+
+guint
+indicator_ng_get_max_update_rate (IndicatorNg *self)
+{
+  g_return_val_if_fail (INDICATOR_IS_NG (self), 0);
+
+  return self->max_update_rate;
+}
+
+/**
+ * indicator_ng_get_dropped_updates:
+ * @indicator: an #IndicatorNg
+ *
+ * Returns: the number of header updates that were dropped because of
+ * the maximum update rate.
+ */
+guint
+indicator_ng_get_dropped_updates (IndicatorNg *self)
+{
+  g_return_val_if_fail (INDICATOR_IS_NG (self), 0);
+
+  return self->dropped_updates;
+}
+
+/**
+ * indicator_ng_set_max_scrolls_in_flight:
+ * @indicator: an #IndicatorNg
+ * @max: the maximum number of unanswered scroll activations, or 0
+ *
+ * Scrolling on the entry activates the service's scroll action at most
+ * once per frame, with the sum of the scroll deltas. When @max is not 0,
+ * no more than @max of these activations are sent before the service
+ * answers them. Scrolling in the meantime is added up and sent with the
+ * next one, so a slow service never builds up a backlog.
+ */
+void
+indicator_ng_set_max_scrolls_in_flight (IndicatorNg *self,
+                                        guint        max)
+{
+  g_return_if_fail (INDICATOR_IS_NG (self));
+
+  if (self->max_scrolls_in_flight == max)
+    return;
+
+  self->max_scrolls_in_flight = max;
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MAX_SCROLLS_IN_FLIGHT]);
+}
+
+guint
+indicator_ng_get_max_scrolls_in_flight (IndicatorNg *self)
+{
+  g_return_val_if_fail (INDICATOR_IS_NG (self), 0);
+
+  return self->max_scrolls_in_flight;
+}
+
+/**
+ * indicator_ng_get_merged_updates:
+ * @indicator: an #IndicatorNg
+ *
+ * Returns: the number of header updates that were merged into an
+ * already pending one while coalescing was enabled.
+ */
+guint
+indicator_ng_get_merged_updates (IndicatorNg *self)
+{
+  g_return_val_if_fail (INDICATOR_IS_NG (self), 0);
+
+  return self->merged_updates;
+}
+
+gboolean
+indicator_ng_get_headless (IndicatorNg *self)
+{
+  g_return_val_if_fail (INDICATOR_IS_NG (self), FALSE);
+
+  return self->headless;
+}
+
+/**
+ * indicator_ng_get_label:
+ * @indicator: an #IndicatorNg
+ *
+ * Returns: the label of the indicator, or %NULL
+ */
+const gchar *
+indicator_ng_get_label (IndicatorNg *self)
+{
+  g_return_val_if_fail (INDICATOR_IS_NG (self), NULL);
+
+  return self->header_valid ? self->header.label : NULL;
+}
+
+/**
+ * indicator_ng_get_icon:
+ * @indicator: an #IndicatorNg
+ *
+ * Returns: (transfer none): the icon of the indicator, or %NULL
+ */
+GIcon *
+indicator_ng_get_icon (IndicatorNg *self)
+{
+  g_return_val_if_fail (INDICATOR_IS_NG (self), NULL);
+
+  return self->icon;
+}
+
+const gchar *
+indicator_ng_get_accessible_desc (IndicatorNg *self)
+{
+  g_return_val_if_fail (INDICATOR_IS_NG (self), NULL);
+
+  return self->accessible_desc;
+}
+
+/**
+ * indicator_ng_get_visible:
+ * @indicator: an #IndicatorNg
+ *
+ * Changes are announced with #IndicatorObject::entry-added and
+ * #IndicatorObject::entry-removed.
+ *
+ * Returns: whether the service wants the indicator to be shown
+ */
+gboolean
+indicator_ng_get_visible (IndicatorNg *self)
+{
+  g_return_val_if_fail (INDICATOR_IS_NG (self), FALSE);
+
+  return indicator_object_entry_is_visible (INDICATOR_OBJECT (self), &self->entry);
+}
+
+/**
+ * indicator_ng_get_menu_model:
+ * @indicator: an #IndicatorNg
+ *
+ * Returns: (transfer none): the model of the popup menu, or %NULL while
+ * the service isn't running
+ */
+GMenuModel *
+indicator_ng_get_menu_model (IndicatorNg *self)
+{
+  g_return_val_if_fail (INDICATOR_IS_NG (self), NULL);
+
+  return self->popup;
+}
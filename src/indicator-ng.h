@@ -21,6 +21,7 @@
 #define __INDICATOR_NG_H__
 
 #include "indicator-object.h"
+#include "indicator-ng-index.h"
 
 #define INDICATOR_TYPE_NG            (indicator_ng_get_type ())
 #define INDICATOR_NG(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), INDICATOR_TYPE_NG, IndicatorNg))
@@ -41,8 +42,64 @@ IndicatorNg *      indicator_ng_new_for_profile     (const gchar  *service_file,
                                                      const gchar  *profile,
                                                      GError      **error);
 
+IndicatorNg *      indicator_ng_new_headless        (const gchar  *service_file,
+                                                     const gchar  *profile,
+                                                     GError      **error);
+
+IndicatorNg *      indicator_ng_new_from_index_record (const IndicatorNgIndexRecord *record);
+
+void               indicator_ng_new_for_profile_async  (const gchar         *service_file,
+                                                        const gchar         *profile,
+                                                        GCancellable        *cancellable,
+                                                        GAsyncReadyCallback  callback,
+                                                        gpointer             user_data);
+
+IndicatorNg *      indicator_ng_new_for_profile_finish (GAsyncResult  *result,
+                                                        GError       **error);
+
 const gchar *      indicator_ng_get_service_file    (IndicatorNg *indicator);
 
 const gchar *      indicator_ng_get_profile         (IndicatorNg *indicator);
 
+void               indicator_ng_set_lazy_menu       (IndicatorNg *indicator,
+                                                     gboolean     lazy);
+
+gboolean           indicator_ng_get_lazy_menu       (IndicatorNg *indicator);
+
+void               indicator_ng_set_prewarm_menu    (IndicatorNg *indicator,
+                                                     gboolean     prewarm);
+
+gboolean           indicator_ng_get_prewarm_menu    (IndicatorNg *indicator);
+
+void               indicator_ng_set_coalesce_updates (IndicatorNg *indicator,
+                                                      gboolean     coalesce);
+
+gboolean           indicator_ng_get_coalesce_updates (IndicatorNg *indicator);
+
+guint              indicator_ng_get_merged_updates  (IndicatorNg *indicator);
+
+void               indicator_ng_set_max_update_rate (IndicatorNg *indicator,
+                                                     guint        rate);
+
+guint              indicator_ng_get_max_update_rate (IndicatorNg *indicator);
+
+guint              indicator_ng_get_dropped_updates (IndicatorNg *indicator);
+
+void               indicator_ng_set_max_scrolls_in_flight (IndicatorNg *indicator,
+                                                           guint        max);
+
+guint              indicator_ng_get_max_scrolls_in_flight (IndicatorNg *indicator);
+
+gboolean           indicator_ng_get_headless        (IndicatorNg *indicator);
+
+const gchar *      indicator_ng_get_label           (IndicatorNg *indicator);
+
+GIcon *            indicator_ng_get_icon            (IndicatorNg *indicator);
+
+const gchar *      indicator_ng_get_accessible_desc (IndicatorNg *indicator);
+
+gboolean           indicator_ng_get_visible         (IndicatorNg *indicator);
+
+GMenuModel *       indicator_ng_get_menu_model      (IndicatorNg *indicator);
+
 #endif
@@ -25,10 +25,13 @@ License along with this library. If not, see
 #include "config.h"
 #endif
 
+#include <stdlib.h>
+
 #include "indicator.h"
 #include "indicator-object.h"
 #include "indicator-object-marshal.h"
 #include "indicator-object-enum-types.h"
+#include "indicator-trace.h"
 
 /**
 	@ENTRY_INIT: The entry hasn't been initialized yet, so its
@@ -44,24 +47,70 @@ typedef enum {
 EntryVisibility;
 
 typedef struct _IndicatorObjectEntryPrivate {
+     IndicatorObjectEntry * entry;
      EntryVisibility visibility;
+     gboolean live;
 }
 IndicatorObjectEntryPrivate;
 
+/**
+	ModuleRecord:
+	@path: The canonical path of the module, its key in the registry
+	@module: The opened module, its version already checked
+	@get_type: The module's #get_type_t
+	@instances: The number of objects built from the module, plus the
+		ones still being built
+	@keep_warm_id: The timeout that closes the module when it has been
+		unused for the keep-warm period
+
+	An entry in the process-wide registry of opened modules, so that
+	creating the same indicator again doesn't open it again.
+*/
+typedef struct _ModuleRecord {
+	gchar * path;
+	GModule * module;
+	get_type_t get_type;
+	guint instances;
+	guint keep_warm_id;
+}
+ModuleRecord;
+
+/* Modules are opened on worker threads too, see
+   indicator_object_new_from_files_async() */
+G_LOCK_DEFINE_STATIC (module_registry);
+static GHashTable * module_registry = NULL;
+static guint module_keep_warm = 0;
+/* How many times module_open() found the module in the registry */
+static guint module_registry_hits = 0;
+
+/* The entry states are only pruned when there are at least this many
+   of them and twice as many as were left after the last pruning */
+#define ENTRY_PRIVATES_PRUNE_MIN 8
+
 /**
 	IndicatorObjectPrivate:
-	@module: The loaded module representing the object.  Note to
-		subclasses: This will not be set when you're initalized.
+	@module: The registry record of the loaded module representing
+		the object.  Note to subclasses: This will not be set when
+		you're initalized.
 	@entry: A default entry for objects that don't need all the
 		fancy stuff.  This works with #get_entries_default.
 	@gotten_entries: A check to see if the @entry has been
 		populated intelligently yet.
+	@entry_privates: The #IndicatorObjectEntryPrivate of the
+		entries, searched linearly as there are only a few.
+	@entry_privates_pruned: The number of entry states that were
+		left after states of entries that are gone were dropped.
+	@entries_frozen: The freeze count of entries-changed.
+	@added_entries: Entries added since entries-changed was last
+		emitted, or #NULL.
+	@removed_entries: Entries removed since entries-changed was last
+		emitted, or #NULL.
 
 	Structure to define the memory for the private area
 	of the object instance.
 */
 struct _IndicatorObjectPrivate {
-	GModule * module;
+	ModuleRecord * module;
 
 	/* For get_entries_default */
 	IndicatorObjectEntry entry;
@@ -69,7 +118,13 @@ struct _IndicatorObjectPrivate {
 
 	/* Whether or not entries are visible by default */
 	gboolean default_visibility;
-	GHashTable * entry_privates;
+	GArray * entry_privates;
+	guint entry_privates_pruned;
+
+	/* Batching of entries-changed */
+	guint entries_frozen;
+	GPtrArray * added_entries;
+	GPtrArray * removed_entries;
 
 	GStrv environments;
 };
@@ -84,6 +139,8 @@ enum {
 	SHOW_NOW_CHANGED,
 	ACCESSIBLE_DESC_UPDATE,
 	SECONDARY_ACTIVATE,
+	ENTRIES_CHANGED,
+	GET_STATS,
 	LAST_SIGNAL
 };
 
@@ -110,10 +167,14 @@ static void get_property (GObject*, guint prop_id,       GValue*, GParamSpec* );
 /* entries' visibility */
 static GList * get_entries_default               (IndicatorObject*);
 static GList * get_all_entries                   (IndicatorObject*);
+static void foreach_all_entries                  (IndicatorObject*, IndicatorObjectEntryFunc, gpointer);
+static gboolean entry_is_shown                   (IndicatorObject*, IndicatorObjectEntry*);
 static void indicator_object_entry_being_removed (IndicatorObject*, IndicatorObjectEntry*);
 static void indicator_object_entry_was_added     (IndicatorObject*, IndicatorObjectEntry*);
 static gint indicator_object_real_get_position   (IndicatorObject*);
+static void indicator_object_real_get_stats      (IndicatorObject*, GVariantBuilder*);
 static IndicatorObjectEntryPrivate * entry_get_private (IndicatorObject*, IndicatorObjectEntry*);
+static void entries_changed_record               (IndicatorObject*, IndicatorObjectEntry*, gboolean);
 
 G_DEFINE_TYPE_WITH_PRIVATE (IndicatorObject, indicator_object, G_TYPE_OBJECT);
 
@@ -285,6 +346,50 @@ indicator_object_class_init (IndicatorObjectClass *klass)
 	                                     g_cclosure_marshal_VOID__POINTER,
 	                                     G_TYPE_NONE, 1, G_TYPE_POINTER, G_TYPE_NONE);
 
+	/**
+		IndicatorObject::entries-changed:
+		@arg0: The #IndicatorObject object
+		@arg1: (element-type IndicatorObjectEntry): The entries
+			that were added
+		@arg2: (element-type IndicatorObjectEntry): The entries
+			that were removed
+
+		Signaled once for a batch of #IndicatorObject::entry-added
+		and #IndicatorObject::entry-removed signals, so that the
+		displayer of the indicator can relayout only once.  Without
+		indicator_object_freeze_entries() every added or removed entry
+		is a batch of its own, except for the ones of
+		indicator_object_set_visible().  An entry that is added and
+		removed again within a batch is in neither array.
+	*/
+	signals[ENTRIES_CHANGED] = g_signal_new (INDICATOR_OBJECT_SIGNAL_ENTRIES_CHANGED,
+	                                         G_TYPE_FROM_CLASS(klass),
+	                                         G_SIGNAL_RUN_LAST,
+	                                         0,
+	                                         NULL, NULL,
+	                                         _indicator_object_marshal_VOID__BOXED_BOXED,
+	                                         G_TYPE_NONE, 2, G_TYPE_PTR_ARRAY, G_TYPE_PTR_ARRAY);
+
+	/**
+		IndicatorObject::get-stats:
+		@arg0: The #IndicatorObject object
+		@arg1: The a{sv} #GVariantBuilder to add to
+
+		Emitted by indicator_object_get_stats() to collect the
+		runtime statistics.  The default handler adds the generic
+		ones.  Subclasses override it with
+		g_signal_override_class_handler() and chain up with
+		g_signal_chain_from_overridden_handler(), which keeps the
+		class structure free of another virtual function.
+	*/
+	signals[GET_STATS] = g_signal_new_class_handler (INDICATOR_OBJECT_SIGNAL_GET_STATS,
+	                                                 G_TYPE_FROM_CLASS(klass),
+	                                                 G_SIGNAL_RUN_LAST,
+	                                                 G_CALLBACK (indicator_object_real_get_stats),
+	                                                 NULL, NULL,
+	                                                 g_cclosure_marshal_VOID__POINTER,
+	                                                 G_TYPE_NONE, 1, G_TYPE_POINTER);
+
 	/* Properties */
 
 	GParamSpec * pspec = g_param_spec_boolean (INDICATOR_OBJECT_DEFAULT_VISIBILITY,
@@ -313,7 +418,14 @@ indicator_object_init (IndicatorObject *self)
 
 	priv->gotten_entries = FALSE;
 	priv->default_visibility = TRUE;
-	priv->entry_privates = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+	/* room for the states of the entries of most objects, so that
+	   seeing an entry for the first time doesn't allocate */
+	priv->entry_privates = g_array_sized_new (FALSE, FALSE, sizeof (IndicatorObjectEntryPrivate), ENTRY_PRIVATES_PRUNE_MIN);
+	priv->entry_privates_pruned = 0;
+
+	priv->entries_frozen = 0;
+	priv->added_entries = NULL;
+	priv->removed_entries = NULL;
 
 	priv->environments = NULL;
 
@@ -339,15 +451,66 @@ indicator_object_dispose (GObject *object)
 	G_OBJECT_CLASS (indicator_object_parent_class)->dispose (object);
 }
 
-/* A small helper function that closes a module but
-   in the function prototype of a GSourceFunc. */
-static gboolean
-module_unref (gpointer data)
+/* Closes the module and drops it from the registry, the
+   registry has to be locked */
+static void
+module_record_close (ModuleRecord * record)
 {
-	if (!g_module_close((GModule *)data)) {
+	g_hash_table_remove (module_registry, record->path);
+
+	if (!g_module_close(record->module)) {
 		/* All we can do is warn. */
 		g_warning("Unable to close module!");
 	}
+
+	g_free (record->path);
+	g_free (record);
+}
+
+static gboolean
+module_keep_warm_expired (gpointer data)
+{
+	ModuleRecord * record = data;
+
+	G_LOCK (module_registry);
+	record->keep_warm_id = 0;
+	if (record->instances == 0) {
+		module_record_close (record);
+	}
+	G_UNLOCK (module_registry);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Drops an instance of the module, which is closed when it was the
+   last one, right away or after the keep-warm period */
+static void
+module_release (ModuleRecord * record)
+{
+	G_LOCK (module_registry);
+
+	if (--record->instances == 0) {
+		if (record->keep_warm_id != 0) {
+			g_source_remove (record->keep_warm_id);
+			record->keep_warm_id = 0;
+		}
+
+		if (module_keep_warm > 0) {
+			record->keep_warm_id = g_timeout_add_seconds (module_keep_warm, module_keep_warm_expired, record);
+		} else {
+			module_record_close (record);
+		}
+	}
+
+	G_UNLOCK (module_registry);
+}
+
+/* A small helper function that releases a module but
+   in the function prototype of a GSourceFunc. */
+static gboolean
+module_unref (gpointer data)
+{
+	module_release (data);
 	return FALSE;
 }
 
@@ -360,10 +523,13 @@ indicator_object_finalize (GObject *object)
 	IndicatorObjectPrivate * priv = indicator_object_get_instance_private(obj);
 
 	if (priv->entry_privates != NULL) {
-		g_hash_table_destroy (priv->entry_privates);
+		g_array_free (priv->entry_privates, TRUE);
 		priv->entry_privates = NULL;
 	}
 
+	g_clear_pointer (&priv->added_entries, g_ptr_array_unref);
+	g_clear_pointer (&priv->removed_entries, g_ptr_array_unref);
+
 	if (priv->environments != NULL) {
 		g_strfreev(priv->environments);
 		priv->environments = NULL;
@@ -385,22 +551,17 @@ indicator_object_finalize (GObject *object)
 	return;
 }
 
-/**
-	indicator_object_new_from_file:
-	@file: Filename containing a loadable module
-
-	This function builds an #IndicatorObject using the symbols
-	that are found in @file.  The module is loaded and the
-	references are all kept by the object.  To unload the
-	module the object must be destroyed.
-
-	Return value: A valid #IndicatorObject or #NULL if error.
-*/
-IndicatorObject *
-indicator_object_new_from_file (const gchar * file)
+/* Returns the registry record of the module in @file, opening it
+   and checking that it speaks our version of the API unless it is in
+   the registry already.  The caller owns an instance of the module.
+   Only uses thread-safe GModule calls, so that modules can be opened
+   on worker threads. */
+static ModuleRecord *
+module_open (const gchar * file)
 {
-	GObject * object = NULL;
 	GModule * module = NULL;
+	ModuleRecord * record = NULL;
+	gchar * path = NULL;
 
 	/* Check to make sure the name exists and that the
 	   file itself exists */
@@ -414,27 +575,48 @@ indicator_object_new_from_file (const gchar * file)
 		return NULL;
 	}
 
+	/* The same module may be reached through different paths */
+	char * real_path = realpath(file, NULL);
+	path = g_strdup(real_path != NULL ? real_path : file);
+	free(real_path);
+
+	G_LOCK (module_registry);
+	if (module_registry == NULL) {
+		module_registry = g_hash_table_new (g_str_hash, g_str_equal);
+	}
+	record = g_hash_table_lookup (module_registry, path);
+	if (record != NULL) {
+		record->instances++;
+		module_registry_hits++;
+	}
+	G_UNLOCK (module_registry);
+
+	if (record != NULL) {
+		g_free (path);
+		return record;
+	}
+
 	/* Grab the g_module reference, pull it in but let's
 	   keep the symbols local to avoid conflicts. */
 	module = g_module_open(file,
                            G_MODULE_BIND_LAZY | G_MODULE_BIND_LOCAL);
 	if (module == NULL) {
 		g_warning("Unable to load module: %s", file);
-		return NULL;
+		goto closeandout;
 	}
 
 	/* Look for the version function, error if not found. */
 	get_version_t lget_version = NULL;
 	if (!g_module_symbol(module, INDICATOR_GET_VERSION_S, (gpointer *)(&lget_version))) {
 		g_warning("Unable to get the symbol for getting the version.");
-		return NULL;
+		goto closeandout;
 	}
 
 	/* Check the version with the macro and make sure we're
 	   all talking the same language. */
 	if (!INDICATOR_VERSION_CHECK(lget_version())) {
 		g_warning("Indicator using API version '%s' we're expecting '%s'", lget_version(), INDICATOR_VERSION);
-		return NULL;
+		goto closeandout;
 	}
 
 	/* The function for grabbing a label from the module
@@ -442,12 +624,48 @@ indicator_object_new_from_file (const gchar * file)
 	get_type_t lget_type = NULL;
 	if (!g_module_symbol(module, INDICATOR_GET_TYPE_S, (gpointer *)(&lget_type))) {
 		g_warning("Unable to get '" INDICATOR_GET_TYPE_S "' symbol from module: %s", file);
-		goto unrefandout;
+		goto closeandout;
 	}
 	if (lget_type == NULL) {
 		g_warning("Symbol '" INDICATOR_GET_TYPE_S "' is (null) in module: %s", file);
-		goto unrefandout;
+		goto closeandout;
+	}
+
+	/* Another thread may have opened it in the meantime, then
+	   ours is just another reference to the same module */
+	G_LOCK (module_registry);
+	record = g_hash_table_lookup (module_registry, path);
+	if (record != NULL) {
+		record->instances++;
+		module_registry_hits++;
+	} else {
+		record = g_new0 (ModuleRecord, 1);
+		record->path = path;
+		record->module = module;
+		record->get_type = lget_type;
+		record->instances = 1;
+		g_hash_table_insert (module_registry, record->path, record);
+		path = NULL;
+		module = NULL;
 	}
+	G_UNLOCK (module_registry);
+
+closeandout:
+	if (module != NULL) {
+		g_module_close(module);
+	}
+	g_free (path);
+	return record;
+}
+
+/* Builds the object from a module opened by module_open(), taking over
+   its instance of the module.  Registers the type, so this has to run
+   on the main thread. */
+static IndicatorObject *
+object_new_from_module (ModuleRecord * module, const gchar * file)
+{
+	GObject * object = NULL;
+	get_type_t lget_type = module->get_type;
 
 	/* A this point we allocate the object, any code beyond
 	   here needs to deallocate it if we're returning in an
@@ -473,18 +691,258 @@ indicator_object_new_from_file (const gchar * file)
 	   this happens. */
 unrefandout:
 	g_clear_object (&object);
-	g_clear_object (&module);
+	module_release (module);
 	g_warning("Error building IndicatorObject from file: %s", file);
 	return NULL;
 }
 
+/**
+	indicator_object_set_module_keep_warm:
+	@seconds: How long to keep unused modules open, or 0
+
+	Modules are opened once per process and shared by all of the
+	objects that are built from them, however they are reached.  By
+	default a module is closed as soon as its last object is gone.
+	Hosts that destroy and create the same indicators again, e.g. on
+	monitor hotplug, can keep the modules open for @seconds after
+	that, so that they are neither closed nor opened again.  Setting
+	it back to 0 closes the modules that are only kept warm.
+*/
+void
+indicator_object_set_module_keep_warm (guint seconds)
+{
+	G_LOCK (module_registry);
+	module_keep_warm = seconds;
+
+	if (seconds == 0 && module_registry != NULL) {
+		GList * values = g_hash_table_get_values (module_registry);
+		GList * l;
+
+		/* module_record_close() drops the records from the registry,
+		   so not while iterating over it */
+		for (l = values; l != NULL; l = l->next) {
+			ModuleRecord * record = l->data;
+
+			if (record->keep_warm_id == 0 || record->instances > 0)
+				continue;
+
+			g_source_remove (record->keep_warm_id);
+			record->keep_warm_id = 0;
+			module_record_close (record);
+		}
+
+		g_list_free (values);
+	}
+
+	G_UNLOCK (module_registry);
+}
+
+/**
+	indicator_object_get_module_stats:
+
+	Collects the statistics of the modules opened by the process, which
+	are shared by all of the objects: "modules" is the number of modules
+	that are open, "module-registry-hits" the number of times a module
+	was found already open instead of being opened again.
+
+	Return value: (transfer full): A new a{sv} #GVariant
+*/
+GVariant *
+indicator_object_get_module_stats (void)
+{
+	GVariantBuilder builder;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+
+	G_LOCK (module_registry);
+	g_variant_builder_add (&builder, "{sv}", "modules", g_variant_new_uint32 (module_registry ? g_hash_table_size (module_registry) : 0));
+	g_variant_builder_add (&builder, "{sv}", "module-registry-hits", g_variant_new_uint32 (module_registry_hits));
+	G_UNLOCK (module_registry);
+
+	return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+/**
+	indicator_object_new_from_file:
+	@file: Filename containing a loadable module
+
+	This function builds an #IndicatorObject using the symbols
+	that are found in @file.  The module is loaded and the
+	references are all kept by the object.  To unload the
+	module the object must be destroyed.
+
+	Return value: A valid #IndicatorObject or #NULL if error.
+*/
+IndicatorObject *
+indicator_object_new_from_file (const gchar * file)
+{
+	ModuleRecord * module = NULL;
+	/* Modules are only known by their file until loaded */
+	INDICATOR_TRACE_SCOPE("new-from-file", file);
+
+	module = module_open (file);
+	if (module == NULL) {
+		return NULL;
+	}
+
+	return object_new_from_module (module, file);
+}
+
+typedef struct {
+	gchar ** files;
+	ModuleRecord ** modules;
+	guint pending;
+} NewFromFilesData;
+
+static void
+new_from_files_data_free (gpointer data)
+{
+	NewFromFilesData * files_data = data;
+	guint i;
+
+	/* Modules that didn't make it into an object */
+	for (i = 0; files_data->files[i] != NULL; i++) {
+		if (files_data->modules[i] != NULL) {
+			module_release (files_data->modules[i]);
+		}
+	}
+
+	g_strfreev (files_data->files);
+	g_free (files_data->modules);
+	g_free (files_data);
+}
+
+static void
+new_from_files_objects_free (gpointer data)
+{
+	g_list_free_full (data, g_object_unref);
+}
+
+static void
+module_open_thread (GTask * task, gpointer source_object, gpointer task_data, GCancellable * cancellable)
+{
+	g_task_return_pointer (task, module_open (task_data), NULL);
+}
+
+/* Back on the main thread, once the last module is open the objects
+   are built in the order of the files */
+static void
+module_opened (GObject * source_object, GAsyncResult * result, gpointer user_data)
+{
+	GTask * task = user_data;
+	NewFromFilesData * files_data = g_task_get_task_data (task);
+	guint index = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (result), "indicator-file-index"));
+	GList * objects = NULL;
+	guint i;
+
+	files_data->modules[index] = g_task_propagate_pointer (G_TASK (result), NULL);
+
+	if (--files_data->pending > 0) {
+		g_object_unref (task);
+		return;
+	}
+
+	if (g_task_return_error_if_cancelled (task)) {
+		g_object_unref (task);
+		return;
+	}
+
+	for (i = 0; files_data->files[i] != NULL; i++) {
+		if (files_data->modules[i] != NULL) {
+			IndicatorObject * object = object_new_from_module (files_data->modules[i], files_data->files[i]);
+
+			files_data->modules[i] = NULL;
+			if (object != NULL) {
+				objects = g_list_prepend (objects, object);
+			}
+		}
+	}
+
+	g_task_return_pointer (task, g_list_reverse (objects), new_from_files_objects_free);
+	g_object_unref (task);
+}
+
+/**
+	indicator_object_new_from_files_async:
+	@files: (array zero-terminated=1): Filenames containing loadable modules
+	@cancellable: (allow-none): A #GCancellable
+	@callback: Called when all of the objects are built
+	@user_data: Data for @callback
+
+	Asynchronous version of indicator_object_new_from_file() for many
+	modules at once.  The modules are opened and their versions are
+	checked concurrently on worker threads, which is where most of the
+	time goes for large modules.  Their types are then registered and
+	the objects are built on the thread that called this, where
+	@callback should call indicator_object_new_from_files_finish().
+
+	Module constructors, if a module has any, run on a worker thread.
+*/
+void
+indicator_object_new_from_files_async (const gchar * const * files, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+	g_return_if_fail(files != NULL);
+
+	GTask * task = g_task_new (NULL, cancellable, callback, user_data);
+	NewFromFilesData * files_data = g_new0 (NewFromFilesData, 1);
+	guint i;
+
+	g_task_set_source_tag (task, indicator_object_new_from_files_async);
+
+	files_data->files = g_strdupv ((gchar **) files);
+	files_data->pending = g_strv_length (files_data->files);
+	files_data->modules = g_new0 (ModuleRecord *, files_data->pending + 1);
+	g_task_set_task_data (task, files_data, new_from_files_data_free);
+
+	if (files_data->pending == 0) {
+		g_task_return_pointer (task, NULL, NULL);
+		g_object_unref (task);
+		return;
+	}
+
+	/* Each subtask keeps a reference on the task until it's back */
+	for (i = 0; files_data->files[i] != NULL; i++) {
+		GTask * open_task = g_task_new (NULL, cancellable, module_opened, g_object_ref (task));
+
+		g_object_set_data (G_OBJECT (open_task), "indicator-file-index", GUINT_TO_POINTER (i));
+		g_task_set_task_data (open_task, files_data->files[i], NULL);
+		/* The module has to come back even when cancelled, to be closed */
+		g_task_set_check_cancellable (open_task, FALSE);
+		g_task_run_in_thread (open_task, module_open_thread);
+		g_object_unref (open_task);
+	}
+
+	g_object_unref (task);
+}
+
+/**
+	indicator_object_new_from_files_finish:
+	@result: The #GAsyncResult passed to the callback
+	@error: Return location for a #GError
+
+	Finishes indicator_object_new_from_files_async().  Modules that
+	can't be loaded are skipped with a warning, like
+	indicator_object_new_from_file() does.
+
+	Return value: (element-type IndicatorObject) (transfer full):
+		The new objects in the order of the files, free with
+		g_list_free_full() and g_object_unref().
+*/
+GList *
+indicator_object_new_from_files_finish (GAsyncResult * result, GError ** error)
+{
+	g_return_val_if_fail(g_task_is_valid (result, NULL), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 /* The default get entries function uses the other single
    entries in the class to create an entry structure and
    put it into a list.  This makes it simple for simple objects
    to create the list.  Small changes from the way they
    previously were. */
-static GList *
-get_entries_default (IndicatorObject * io)
+static IndicatorObjectEntry *
+get_default_entry (IndicatorObject * io)
 {
 	IndicatorObjectPrivate * priv = indicator_object_get_instance_private(io);
 
@@ -534,7 +992,15 @@ get_entries_default (IndicatorObject * io)
 		priv->gotten_entries = TRUE;
 	}
 
-	return g_list_append(NULL, &(priv->entry));
+	return &(priv->entry);
+}
+
+static GList *
+get_entries_default (IndicatorObject * io)
+{
+	IndicatorObjectEntry * entry = get_default_entry (io);
+
+	return entry ? g_list_append(NULL, entry) : NULL;
 }
 
 /* returns a list of all IndicatorObjectEntries, visible or not */
@@ -564,23 +1030,139 @@ get_all_entries (IndicatorObject * io)
 	return all_entries;
 }
 
-/* get the private structure that corresponds to a caller-specified entry */
+typedef struct {
+	IndicatorObjectEntryFunc func;
+	gpointer user_data;
+} ForeachData;
+
+static void
+foreach_set_parent (IndicatorObject * io, IndicatorObjectEntry * entry, gpointer user_data)
+{
+	ForeachData * data = user_data;
+
+	if (entry) {
+		entry->parent_object = io;
+		data->func (io, entry, data->user_data);
+	}
+}
+
+/* calls func for all IndicatorObjectEntries, visible or not, without
+   allocating unless the class only has a get_entries function */
+static void
+foreach_all_entries (IndicatorObject * io, IndicatorObjectEntryFunc func, gpointer user_data)
+{
+	IndicatorObjectClass * class = INDICATOR_OBJECT_GET_CLASS(io);
+
+	if (class->get_entries == get_entries_default) {
+		IndicatorObjectEntry * entry = get_default_entry (io);
+
+		if (entry) {
+			entry->parent_object = io;
+			func (io, entry, user_data);
+		}
+	} else if (class->foreach_entry) {
+		ForeachData data = { func, user_data };
+
+		class->foreach_entry (io, foreach_set_parent, &data);
+	} else {
+		GList * l;
+		GList * all_entries = get_all_entries (io);
+
+		for (l = all_entries; l; l = l->next)
+			if (l->data)
+				func (io, l->data, user_data);
+
+		g_list_free (all_entries);
+	}
+}
+
+static void
+foreach_visible (IndicatorObject * io, IndicatorObjectEntry * entry, gpointer user_data)
+{
+	ForeachData * data = user_data;
+
+	if (entry_is_shown (io, entry))
+		data->func (io, entry, data->user_data);
+}
+
+static void
+entry_private_mark_live (IndicatorObject * io, IndicatorObjectEntry * entry, gpointer user_data)
+{
+	GArray * privates = user_data;
+	guint i;
+
+	for (i = 0; i < privates->len; i++) {
+		IndicatorObjectEntryPrivate * priv = &g_array_index (privates, IndicatorObjectEntryPrivate, i);
+
+		if (priv->entry == entry) {
+			priv->live = TRUE;
+			break;
+		}
+	}
+}
+
+/* drops the states of the entries that the object doesn't have anymore */
+static void
+entry_privates_prune (IndicatorObject * io)
+{
+	GArray * privates = io->priv->entry_privates;
+	guint i, n_live = 0;
+
+	for (i = 0; i < privates->len; i++)
+		g_array_index (privates, IndicatorObjectEntryPrivate, i).live = FALSE;
+
+	foreach_all_entries (io, entry_private_mark_live, privates);
+
+	for (i = 0; i < privates->len; i++) {
+		IndicatorObjectEntryPrivate * priv = &g_array_index (privates, IndicatorObjectEntryPrivate, i);
+
+		if (priv->live)
+			g_array_index (privates, IndicatorObjectEntryPrivate, n_live++) = *priv;
+	}
+
+	g_array_set_size (privates, n_live);
+	io->priv->entry_privates_pruned = n_live;
+}
+
+/* get the private structure that corresponds to a caller-specified entry.
+   The pointer is only valid until the next call. */
 static IndicatorObjectEntryPrivate *
 entry_get_private (IndicatorObject * io, IndicatorObjectEntry * entry)
 {
 	g_return_val_if_fail (INDICATOR_IS_OBJECT(io), NULL);
 	g_return_val_if_fail (io->priv != NULL, NULL);
 
-	GHashTable * h = io->priv->entry_privates;
-	IndicatorObjectEntryPrivate * priv = g_hash_table_lookup (h, entry);
-	if (priv == NULL)
-	{
-		priv = g_new0 (IndicatorObjectEntryPrivate, 1);
-		priv->visibility = ENTRY_INIT;
-		g_hash_table_insert (h, entry, priv);
+	GArray * privates = io->priv->entry_privates;
+	IndicatorObjectEntryPrivate new_priv = { entry, ENTRY_INIT, FALSE };
+	guint i;
+
+	for (i = 0; i < privates->len; i++) {
+		IndicatorObjectEntryPrivate * priv = &g_array_index (privates, IndicatorObjectEntryPrivate, i);
+
+		if (priv->entry == entry)
+			return priv;
 	}
 
-	return priv;
+	if (privates->len >= MAX (ENTRY_PRIVATES_PRUNE_MIN, 2 * io->priv->entry_privates_pruned))
+		entry_privates_prune (io);
+
+	g_array_append_val (privates, new_priv);
+
+	return &g_array_index (privates, IndicatorObjectEntryPrivate, privates->len - 1);
+}
+
+/* whether the entry is visible, taking the default visibility into account */
+static gboolean
+entry_is_shown (IndicatorObject * io, IndicatorObjectEntry * entry)
+{
+	IndicatorObjectPrivate * priv = indicator_object_get_instance_private(io);
+
+	switch (entry_get_private(io,entry)->visibility) {
+		case ENTRY_VISIBLE:   return TRUE;
+		case ENTRY_INVISIBLE: return FALSE;
+		case ENTRY_INIT:      return priv->default_visibility;
+		default:              g_warn_if_reached(); return TRUE;
+	}
 }
 
 /**
@@ -602,22 +1184,12 @@ indicator_object_get_entries (IndicatorObject * io)
 	GList * l;
 	GList * ret = NULL;
 	GList * all_entries = get_all_entries (io);
-	IndicatorObjectPrivate * priv = indicator_object_get_instance_private(io);
-	const gboolean default_visibility = priv->default_visibility;
 
 	for (l=all_entries; l!=NULL; l=l->next)
 	{
-		gboolean show_me;
 		IndicatorObjectEntry * entry = l->data;
 
-		switch (entry_get_private(io,entry)->visibility) {
-			case ENTRY_VISIBLE:   show_me = TRUE; break;
-			case ENTRY_INVISIBLE: show_me = FALSE; break;
-			case ENTRY_INIT:      show_me = default_visibility; break;
-			default:              show_me = TRUE; g_warn_if_reached(); break;
-		}
-
-		if (show_me)
+		if (entry_is_shown (io, entry))
 			ret = g_list_prepend (ret, entry);
 	}
 
@@ -625,6 +1197,35 @@ indicator_object_get_entries (IndicatorObject * io)
 	return g_list_reverse (ret);
 }
 
+/**
+	indicator_object_foreach_entry:
+	@io: #IndicatorObject to query
+	@func: (scope call): Function to call for each visible entry
+	@user_data: Data to pass to @func
+
+	Calls @func for each of the entries that indicator_object_get_entries()
+	would return, in the same order, but without allocating a list.
+	This is meant for callers that walk the entries often, like a
+	panel on every relayout.  @func must not add or remove entries.
+
+	It allocates nothing as long as the object keeps fewer than eight
+	entries and implements #IndicatorObjectClass::foreach_entry or
+	has the default entry.  Objects with more entries may grow their
+	entry states the first time a new entry is seen, and objects that
+	only implement #IndicatorObjectClass::get_entries still build
+	that list.
+*/
+void
+indicator_object_foreach_entry (IndicatorObject * io, IndicatorObjectEntryFunc func, gpointer user_data)
+{
+	g_return_if_fail(INDICATOR_IS_OBJECT(io));
+	g_return_if_fail(func != NULL);
+
+	ForeachData data = { func, user_data };
+
+	foreach_all_entries (io, foreach_visible, &data);
+}
+
 /**
 	indicator_object_get_location:
 	@io: #IndicatorObject to query
@@ -751,6 +1352,77 @@ indicator_object_entry_close (IndicatorObject * io, IndicatorObjectEntry * entry
 	return;
 }
 
+/**
+	indicator_object_entry_pointer_enter:
+	@io: #IndicatorObject to query
+	@entry: The #IndicatorObjectEntry the pointer entered
+
+	Used to tell the indicator that the pointer is hovering over
+	the entry and it is likely to be activated soon.  Indicators
+	that build their menus lazily can use this to start fetching
+	it.
+*/
+void
+indicator_object_entry_pointer_enter (IndicatorObject * io, IndicatorObjectEntry * entry)
+{
+	g_return_if_fail(INDICATOR_IS_OBJECT(io));
+	IndicatorObjectClass * class = INDICATOR_OBJECT_GET_CLASS(io);
+
+	if (class->entry_pointer_enter != NULL) {
+		return class->entry_pointer_enter(io, entry);
+	}
+
+	return;
+}
+
+static void
+count_entry (IndicatorObject * io, IndicatorObjectEntry * entry, gpointer user_data)
+{
+	guint * counts = user_data;
+
+	counts[0]++;
+	if (entry_is_shown (io, entry))
+		counts[1]++;
+}
+
+static void
+indicator_object_real_get_stats (IndicatorObject * io, GVariantBuilder * builder)
+{
+	guint counts[2] = { 0, 0 };
+
+	foreach_all_entries (io, count_entry, counts);
+
+	g_variant_builder_add (builder, "{sv}", "entries", g_variant_new_uint32 (counts[0]));
+	g_variant_builder_add (builder, "{sv}", "visible-entries", g_variant_new_uint32 (counts[1]));
+	g_variant_builder_add (builder, "{sv}", "entry-states", g_variant_new_uint32 (io->priv->entry_privates->len));
+}
+
+/**
+	indicator_object_get_stats:
+	@io: #IndicatorObject to query
+
+	Collects runtime statistics of the indicator, e.g. to find out
+	which one is expensive or to attach them to a bug report.  All
+	indicators report "entries" and "visible-entries", the other keys
+	depend on the type of the indicator.  Process-wide statistics are
+	reported by indicator_object_get_module_stats().  #IndicatorNg adds counters for header updates, icon
+	reloads, menu rebuilds, IDO recreations and service restarts, and
+	the time spent in its handlers.
+
+	Return value: (transfer full): A new a{sv} #GVariant
+*/
+GVariant *
+indicator_object_get_stats (IndicatorObject * io)
+{
+	g_return_val_if_fail(INDICATOR_IS_OBJECT(io), NULL);
+	GVariantBuilder builder;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_signal_emit(io, signals[GET_STATS], 0, &builder);
+
+	return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
 static void
 indicator_object_entry_being_removed (IndicatorObject * io, IndicatorObjectEntry * entry)
 {
@@ -766,6 +1438,9 @@ indicator_object_entry_being_removed (IndicatorObject * io, IndicatorObjectEntry
 	{
 		class->entry_being_removed (io, entry);
 	}
+
+	/* last, so that handlers see the entry in its new state */
+	entries_changed_record (io, entry, FALSE);
 }
 
 static void
@@ -783,6 +1458,90 @@ indicator_object_entry_was_added (IndicatorObject * io, IndicatorObjectEntry * e
 	{
 		class->entry_was_added (io, entry);
 	}
+
+	/* last, so that handlers see the entry in its new state */
+	entries_changed_record (io, entry, TRUE);
+}
+
+static void
+entries_changed_emit (IndicatorObject * io)
+{
+	IndicatorObjectPrivate * priv = io->priv;
+	GPtrArray * added = priv->added_entries;
+	GPtrArray * removed = priv->removed_entries;
+
+	if (added == NULL && removed == NULL)
+		return;
+
+	priv->added_entries = NULL;
+	priv->removed_entries = NULL;
+
+	if (added == NULL)
+		added = g_ptr_array_new ();
+	if (removed == NULL)
+		removed = g_ptr_array_new ();
+
+	if (added->len > 0 || removed->len > 0)
+		g_signal_emit(io, signals[ENTRIES_CHANGED], 0, added, removed);
+
+	g_ptr_array_unref (added);
+	g_ptr_array_unref (removed);
+}
+
+/* Adds the entry to the pending batch of entries-changed, where an
+   addition and a removal of the same entry cancel out */
+static void
+entries_changed_record (IndicatorObject * io, IndicatorObjectEntry * entry, gboolean added)
+{
+	IndicatorObjectPrivate * priv = io->priv;
+	GPtrArray ** same = added ? &priv->added_entries : &priv->removed_entries;
+	GPtrArray ** opposite = added ? &priv->removed_entries : &priv->added_entries;
+
+	if (*opposite == NULL || !g_ptr_array_remove (*opposite, entry)) {
+		if (*same == NULL)
+			*same = g_ptr_array_new ();
+		g_ptr_array_add (*same, entry);
+	}
+
+	if (priv->entries_frozen == 0)
+		entries_changed_emit (io);
+}
+
+/**
+	indicator_object_freeze_entries:
+	@io: #IndicatorObject to freeze
+
+	Holds back #IndicatorObject::entries-changed until
+	indicator_object_thaw_entries() is called as many times as
+	this was, and then emits it once for all the entries that were
+	added or removed in the meantime.  #IndicatorObject::entry-added
+	and #IndicatorObject::entry-removed are still signaled for every
+	entry.  Entries that are freed while frozen are still in the
+	arrays, so they should only be compared with, not dereferenced.
+*/
+void
+indicator_object_freeze_entries (IndicatorObject * io)
+{
+	g_return_if_fail(INDICATOR_IS_OBJECT(io));
+
+	io->priv->entries_frozen++;
+}
+
+/**
+	indicator_object_thaw_entries:
+	@io: #IndicatorObject to thaw
+
+	Undoes one indicator_object_freeze_entries(), emitting the held
+	back #IndicatorObject::entries-changed on the last one.
+*/
+void
+indicator_object_thaw_entries (IndicatorObject * io)
+{
+	g_return_if_fail(INDICATOR_IS_OBJECT(io));
+	g_return_if_fail(io->priv->entries_frozen > 0);
+
+	if (--io->priv->entries_frozen == 0)
+		entries_changed_emit (io);
 }
 
 static gint
@@ -865,6 +1624,18 @@ indicator_object_check_environment (IndicatorObject * io, const gchar * env)
 	return FALSE;
 }
 
+static void
+set_entry_visible (IndicatorObject * io, IndicatorObjectEntry * entry, gpointer user_data)
+{
+	const gboolean visible = GPOINTER_TO_INT (user_data);
+	const guint signal_id = signals[visible ? ENTRY_ADDED : ENTRY_REMOVED];
+	EntryVisibility visibility = visible ? ENTRY_VISIBLE : ENTRY_INVISIBLE;
+	const GQuark detail = (GQuark)0;
+
+	if (entry_get_private (io, entry)->visibility != visibility)
+		g_signal_emit(io, signal_id, detail, entry);
+}
+
 /**
 	indicator_object_set_visible:
 	@io: #IndicatorObject to check on
@@ -877,18 +1648,9 @@ indicator_object_set_visible (IndicatorObject * io, gboolean visible)
 {
 	g_return_if_fail(INDICATOR_IS_OBJECT(io));
 
-	GList * l;
-	GList * entries = get_all_entries (io);
-	const guint signal_id = signals[visible ? ENTRY_ADDED : ENTRY_REMOVED];
-	EntryVisibility visibility = visible ? ENTRY_VISIBLE : ENTRY_INVISIBLE;
-	const GQuark detail = (GQuark)0;
-
-	for (l=entries; l!=NULL; l=l->next) {
-		IndicatorObjectEntry *entry = l->data;
-		if (entry_get_private (io, entry)->visibility != visibility)
-			g_signal_emit(io, signal_id, detail, entry);
-	}
-	g_list_free (entries);
+	indicator_object_freeze_entries (io);
+	foreach_all_entries (io, set_entry_visible, GINT_TO_POINTER (visible));
+	indicator_object_thaw_entries (io);
 }
 
 static void
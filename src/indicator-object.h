@@ -59,6 +59,10 @@ typedef enum
 #define INDICATOR_OBJECT_SIGNAL_ACCESSIBLE_DESC_UPDATE_ID (g_signal_lookup(INDICATOR_OBJECT_SIGNAL_ACCESSIBLE_DESC_UPDATE, INDICATOR_OBJECT_TYPE))
 #define INDICATOR_OBJECT_SIGNAL_SECONDARY_ACTIVATE "secondary-activate"
 #define INDICATOR_OBJECT_SIGNAL_SECONDARY_ACTIVATE_ID (g_signal_lookup(INDICATOR_OBJECT_SIGNAL_SECONDARY_ACTIVATE, INDICATOR_OBJECT_TYPE))
+#define INDICATOR_OBJECT_SIGNAL_ENTRIES_CHANGED   "entries-changed"
+#define INDICATOR_OBJECT_SIGNAL_ENTRIES_CHANGED_ID (g_signal_lookup(INDICATOR_OBJECT_SIGNAL_ENTRIES_CHANGED, INDICATOR_OBJECT_TYPE))
+#define INDICATOR_OBJECT_SIGNAL_GET_STATS         "get-stats"
+#define INDICATOR_OBJECT_SIGNAL_GET_STATS_ID      (g_signal_lookup(INDICATOR_OBJECT_SIGNAL_GET_STATS, INDICATOR_OBJECT_TYPE))
 
 /* the name of the property to decide whether or not entries are visible by default */
 #define INDICATOR_OBJECT_DEFAULT_VISIBILITY        "indicator-object-default-visibility"
@@ -68,6 +72,8 @@ typedef struct _IndicatorObjectClass   IndicatorObjectClass;
 typedef struct _IndicatorObjectPrivate IndicatorObjectPrivate;
 typedef struct _IndicatorObjectEntry   IndicatorObjectEntry;
 
+typedef void (*IndicatorObjectEntryFunc) (IndicatorObject * io, IndicatorObjectEntry * entry, gpointer user_data);
+
 /**
 	IndicatorObjectClass:
 	@parent_class: #GObjectClass
@@ -103,6 +109,12 @@ typedef struct _IndicatorObjectEntry   IndicatorObjectEntry;
 	@entry_activate: Should be called when the menus for a given
 		entry are shown to the user.
 	@entry_close: Called when the menu is closed.
+	@entry_pointer_enter: Called when the pointer enters an entry, so
+		that its menu can be prepared before it is activated.
+	@foreach_entry: Calls the function for all of the entries of
+		this object, like @get_entries but without building a list.
+		When it isn't set, @get_entries is used instead.  Subclasses
+		that override @get_entries should override this as well.
 	@entry_added: Slot for #IndicatorObject::entry-added
 	@entry_removed: Slot for #IndicatorObject::entry-removed
 	@entry_moved: Slot for #IndicatorObject::entry-moved
@@ -147,10 +159,11 @@ struct _IndicatorObjectClass {
 	gint       (*get_position) (IndicatorObject *io);
 	guint      (*get_parent_window) (IndicatorObject *io);
 
+	void       (*entry_pointer_enter) (IndicatorObject * io, IndicatorObjectEntry * entry);
+	void       (*foreach_entry) (IndicatorObject * io, IndicatorObjectEntryFunc func, gpointer user_data);
+
 	/* Reserved */
 	void       (*reserved1)     (void);
-	void       (*reserved2)     (void);
-	void       (*reserved3)     (void);
 };
 
 /**
@@ -196,8 +209,15 @@ struct _IndicatorObjectEntry {
 
 GType indicator_object_get_type (void);
 IndicatorObject * indicator_object_new_from_file (const gchar * file);
+void    indicator_object_new_from_files_async (const gchar * const * files, GCancellable * cancellable, GAsyncReadyCallback callback, gpointer user_data);
+GList * indicator_object_new_from_files_finish (GAsyncResult * result, GError ** error);
+void    indicator_object_set_module_keep_warm (guint seconds);
+GVariant * indicator_object_get_module_stats (void);
 
 GList * indicator_object_get_entries (IndicatorObject * io);
+void    indicator_object_foreach_entry (IndicatorObject * io, IndicatorObjectEntryFunc func, gpointer user_data);
+void    indicator_object_freeze_entries (IndicatorObject * io);
+void    indicator_object_thaw_entries (IndicatorObject * io);
 guint   indicator_object_get_location (IndicatorObject * io, IndicatorObjectEntry * entry);
 guint   indicator_object_get_show_now (IndicatorObject * io, IndicatorObjectEntry * entry);
 void	indicator_object_set_visible (IndicatorObject * io, gboolean visible);
@@ -205,6 +225,8 @@ gboolean indicator_object_entry_is_visible (IndicatorObject * io, IndicatorObjec
 void    indicator_object_entry_activate (IndicatorObject * io, IndicatorObjectEntry * entry, guint timestamp);
 void    indicator_object_entry_activate_window (IndicatorObject * io, IndicatorObjectEntry * entry, guint windowid, guint timestamp);
 void    indicator_object_entry_close (IndicatorObject * io, IndicatorObjectEntry * entry, guint timestamp);
+void    indicator_object_entry_pointer_enter (IndicatorObject * io, IndicatorObjectEntry * entry);
+GVariant * indicator_object_get_stats (IndicatorObject * io);
 gint    indicator_object_get_position (IndicatorObject *io);
 
 void    indicator_object_set_environment (IndicatorObject * io, GStrv env);
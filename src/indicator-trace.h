@@ -0,0 +1,73 @@
+/*
+ * Copyright 2026 Ayatana Indicators
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_TRACE_H__
+#define __INDICATOR_TRACE_H__
+
+#include <glib-object.h>
+
+/*
+ * Marks for sysprof, in the "libayatana-indicator" group.
+ *
+ * INDICATOR_TRACE_SCOPE() records the time from where it is placed to
+ * the end of the enclosing block, tagged with the name of the indicator
+ * it is working for. Without -DENABLE_TRACING=ON all of this compiles
+ * to nothing, and the name isn't even evaluated.
+ *
+ * Helpers that only get a widget, like the image helper, find the name
+ * through INDICATOR_TRACE_SET_NAME() on that widget.
+ */
+
+#ifdef ENABLE_TRACING
+
+#include <sysprof-capture.h>
+
+#define INDICATOR_TRACE_NAME_DATA "indicator-trace-name"
+
+typedef struct
+{
+  gint64 begin;
+  const gchar *mark;
+  const gchar *name;
+} IndicatorTraceScope;
+
+static inline void
+indicator_trace_scope_end (IndicatorTraceScope *scope)
+{
+  sysprof_collector_mark (scope->begin, SYSPROF_CAPTURE_CURRENT_TIME - scope->begin,
+                          "libayatana-indicator", scope->mark,
+                          "%s", scope->name ? scope->name : "");
+}
+
+#define INDICATOR_TRACE_SCOPE(mark, name) \
+  __attribute__((cleanup (indicator_trace_scope_end))) \
+  IndicatorTraceScope G_PASTE (indicator_trace_scope_, __LINE__) = { SYSPROF_CAPTURE_CURRENT_TIME, (mark), (name) }
+
+#define INDICATOR_TRACE_SET_NAME(object, name) \
+  g_object_set_data_full (G_OBJECT (object), INDICATOR_TRACE_NAME_DATA, g_strdup (name), g_free)
+
+#define INDICATOR_TRACE_GET_NAME(object) \
+  ((const gchar *) g_object_get_data (G_OBJECT (object), INDICATOR_TRACE_NAME_DATA))
+
+#else
+
+#define INDICATOR_TRACE_SCOPE(mark, name) G_STMT_START { } G_STMT_END
+#define INDICATOR_TRACE_SET_NAME(object, name) G_STMT_START { } G_STMT_END
+#define INDICATOR_TRACE_GET_NAME(object) NULL
+
+#endif
+
+#endif
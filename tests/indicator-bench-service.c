@@ -0,0 +1,218 @@
+/*
+ * A synthetic indicator service for indicator-bench.
+ *
+ * It is configured through the environment, which it inherits from the
+ * bus that activates it:
+ *
+ *   INDICATOR_BENCH_RATE            header state changes per second
+ *   INDICATOR_BENCH_ITEMS           number of menu items
+ *   INDICATOR_BENCH_SECTIONS        number of sections they are spread over
+ *   INDICATOR_BENCH_BURST           items-changed emitted per burst
+ *   INDICATOR_BENCH_BURST_INTERVAL  milliseconds between bursts
+ *
+ * The label of every header state is "<sequence> <emit time>", the emit
+ * time being g_get_monotonic_time(), so that the driver can tell how
+ * long it took to reach the label widget.
+ */
+
+#include <stdlib.h>
+#include <gio/gio.h>
+
+typedef struct
+{
+  GSimpleActionGroup *actions;
+  GMenu *menu;
+  GPtrArray *sections;
+
+  guint64 sequence;
+  guint burst;
+  guint burst_item;
+
+  guint actions_export_id;
+  guint menu_export_id;
+} IndicatorBenchService;
+
+static guint
+get_env_uint (const gchar *name,
+              guint        default_value)
+{
+  const gchar *value = g_getenv (name);
+
+  return value ? (guint) g_ascii_strtoull (value, NULL, 10) : default_value;
+}
+
+static gboolean
+update_header (gpointer user_data)
+{
+  IndicatorBenchService *indicator = user_data;
+  GVariantBuilder builder;
+  gchar *label;
+
+  label = g_strdup_printf ("%" G_GUINT64_FORMAT " %" G_GINT64_FORMAT,
+                           ++indicator->sequence, g_get_monotonic_time ());
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&builder, "{sv}", "label", g_variant_new_string (label));
+  g_variant_builder_add (&builder, "{sv}", "icon", g_variant_new_string ("indicator-bench"));
+  g_variant_builder_add (&builder, "{sv}", "accessible-desc", g_variant_new_string ("Bench indicator"));
+  g_variant_builder_add (&builder, "{sv}", "visible", g_variant_new_boolean (TRUE));
+
+  g_action_group_change_action_state (G_ACTION_GROUP (indicator->actions), "_header",
+                                      g_variant_builder_end (&builder));
+
+  g_free (label);
+  return G_SOURCE_CONTINUE;
+}
+
+/* Replaces items round robin over the sections, each replacement
+ * emitting items-changed twice */
+static gboolean
+emit_burst (gpointer user_data)
+{
+  IndicatorBenchService *indicator = user_data;
+  guint i;
+
+  for (i = 0; i < indicator->burst; i++)
+    {
+      GMenu *section = g_ptr_array_index (indicator->sections, indicator->burst_item % indicator->sections->len);
+      gchar *label;
+
+      if (g_menu_model_get_n_items (G_MENU_MODEL (section)) == 0)
+        continue;
+
+      label = g_strdup_printf ("Item %u", indicator->burst_item++);
+      g_menu_remove (section, 0);
+      g_menu_append (section, label, "indicator.item");
+      g_free (label);
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+bus_acquired (GDBusConnection *connection,
+              const gchar     *name,
+              gpointer         user_data)
+{
+  IndicatorBenchService *indicator = user_data;
+  GError *error = NULL;
+  guint rate;
+  guint burst_interval;
+
+  indicator->actions_export_id = g_dbus_connection_export_action_group (connection,
+                                                                        "/org/ayatana/indicator/bench",
+                                                                        G_ACTION_GROUP (indicator->actions),
+                                                                        &error);
+  if (indicator->actions_export_id == 0)
+    {
+      g_warning ("cannot export action group: %s", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  indicator->menu_export_id = g_dbus_connection_export_menu_model (connection,
+                                                                   "/org/ayatana/indicator/bench/desktop",
+                                                                   G_MENU_MODEL (indicator->menu),
+                                                                   &error);
+  if (indicator->menu_export_id == 0)
+    {
+      g_warning ("cannot export menu: %s", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  rate = get_env_uint ("INDICATOR_BENCH_RATE", 10);
+  if (rate > 0)
+    g_timeout_add (MAX (1000 / rate, 1), update_header, indicator);
+
+  indicator->burst = get_env_uint ("INDICATOR_BENCH_BURST", 0);
+  burst_interval = get_env_uint ("INDICATOR_BENCH_BURST_INTERVAL", 1000);
+  if (indicator->burst > 0)
+    g_timeout_add (MAX (burst_interval, 1), emit_burst, indicator);
+}
+
+static void
+name_lost (GDBusConnection *connection,
+           const gchar     *name,
+           gpointer         user_data)
+{
+  IndicatorBenchService *indicator = user_data;
+
+  if (indicator->actions_export_id)
+    g_dbus_connection_unexport_action_group (connection, indicator->actions_export_id);
+
+  if (indicator->menu_export_id)
+    g_dbus_connection_unexport_menu_model (connection, indicator->menu_export_id);
+
+  exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char **argv)
+{
+  IndicatorBenchService indicator = { 0 };
+  GMenuItem *item;
+  GMenu *submenu;
+  GActionEntry entries[] = {
+    { "_header", NULL, NULL, "{'label': <'0 0'>,"
+                             " 'icon': <'indicator-bench'>,"
+                             " 'accessible-desc': <'Bench indicator'> }", NULL },
+    { "item", NULL, NULL, NULL, NULL }
+  };
+  GMainLoop *loop;
+  guint n_items;
+  guint n_sections;
+  guint i;
+
+  n_items = get_env_uint ("INDICATOR_BENCH_ITEMS", 20);
+  n_sections = MAX (get_env_uint ("INDICATOR_BENCH_SECTIONS", 4), 1);
+
+  indicator.actions = g_simple_action_group_new ();
+  g_action_map_add_action_entries (G_ACTION_MAP (indicator.actions), entries, G_N_ELEMENTS (entries), NULL);
+
+  submenu = g_menu_new ();
+  indicator.sections = g_ptr_array_new_with_free_func (g_object_unref);
+  for (i = 0; i < n_sections; i++)
+    {
+      GMenu *section = g_menu_new ();
+
+      g_menu_append_section (submenu, NULL, G_MENU_MODEL (section));
+      g_ptr_array_add (indicator.sections, section);
+    }
+
+  for (i = 0; i < n_items; i++)
+    {
+      gchar *label = g_strdup_printf ("Item %u", i);
+
+      g_menu_append (g_ptr_array_index (indicator.sections, i % n_sections), label, "indicator.item");
+      g_free (label);
+    }
+  indicator.burst_item = n_items;
+
+  item = g_menu_item_new (NULL, "indicator._header");
+  g_menu_item_set_attribute (item, "x-ayatana-type", "s", "org.ayatana.indicator.root");
+  g_menu_item_set_submenu (item, G_MENU_MODEL (submenu));
+  indicator.menu = g_menu_new ();
+  g_menu_append_item (indicator.menu, item);
+
+  g_bus_own_name (G_BUS_TYPE_SESSION,
+                  "org.ayatana.indicator.bench",
+                  G_BUS_NAME_OWNER_FLAGS_NONE,
+                  bus_acquired,
+                  NULL,
+                  name_lost,
+                  &indicator,
+                  NULL);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_main_loop_run (loop);
+
+  g_ptr_array_unref (indicator.sections);
+  g_object_unref (submenu);
+  g_object_unref (item);
+  g_object_unref (indicator.actions);
+  g_object_unref (indicator.menu);
+  g_main_loop_unref (loop);
+
+  return 0;
+}
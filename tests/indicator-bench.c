@@ -0,0 +1,359 @@
+/*
+ * End-to-end benchmark of IndicatorNg against indicator-bench-service.
+ *
+ * Measures the time from the service emitting a header state change to
+ * the label widget showing it, the CPU time this process spends per
+ * update, the time until the indicator first shows up and the time
+ * until its menu is first drawn. The results are written as a single
+ * JSON object to stdout or to the --output file.
+ *
+ * Every option can also be given through the environment of the
+ * service (see indicator-bench-service.c), which is how the "bench"
+ * target is configured, e.g. INDICATOR_BENCH_RATE=100 make bench
+ */
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include "indicator-ng.h"
+
+static gint rate = 10;
+static gint items = 20;
+static gint sections = 4;
+static gint burst = 0;
+static gint burst_interval = 1000;
+static gint duration = 5;
+static gboolean lazy_menu = FALSE;
+static gboolean prewarm_menu = FALSE;
+static gboolean coalesce_updates = FALSE;
+static gchar *output = NULL;
+
+static GOptionEntry options[] = {
+  { "rate", 0, 0, G_OPTION_ARG_INT, &rate, "Header state changes per second", "N" },
+  { "items", 0, 0, G_OPTION_ARG_INT, &items, "Number of menu items", "M" },
+  { "sections", 0, 0, G_OPTION_ARG_INT, &sections, "Number of menu sections", "K" },
+  { "burst", 0, 0, G_OPTION_ARG_INT, &burst, "Items replaced per burst", "B" },
+  { "burst-interval", 0, 0, G_OPTION_ARG_INT, &burst_interval, "Milliseconds between bursts", "MS" },
+  { "duration", 0, 0, G_OPTION_ARG_INT, &duration, "Seconds to measure updates for", "S" },
+  { "lazy-menu", 0, 0, G_OPTION_ARG_NONE, &lazy_menu, "Enable IndicatorNg:lazy-menu", NULL },
+  { "prewarm-menu", 0, 0, G_OPTION_ARG_NONE, &prewarm_menu, "Enable IndicatorNg:prewarm-menu", NULL },
+  { "coalesce-updates", 0, 0, G_OPTION_ARG_NONE, &coalesce_updates, "Enable IndicatorNg:coalesce-updates", NULL },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Write the results to FILE", "FILE" },
+  { NULL }
+};
+
+typedef struct
+{
+  GMainLoop *loop;
+  IndicatorNg *indicator;
+  IndicatorObjectEntry *entry;
+
+  guint startup_timeout_id;
+  gint64 start_time;
+  gint64 startup_time;
+  gint64 menu_time;
+
+  GArray *latencies;
+  guint64 first_sequence;
+  guint64 last_sequence;
+  gint64 cpu_time;
+} IndicatorBench;
+
+static gint64
+get_cpu_time (void)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+
+  return (gint64) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC +
+         usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static gint
+get_env_int (const gchar *name,
+             gint         default_value)
+{
+  const gchar *value = g_getenv (name);
+
+  return value ? (gint) g_ascii_strtoll (value, NULL, 10) : default_value;
+}
+
+static void
+set_env_int (const gchar *name,
+             gint         value)
+{
+  gchar *str = g_strdup_printf ("%d", value);
+
+  g_setenv (name, str, TRUE);
+  g_free (str);
+}
+
+static gint
+compare_int64 (gconstpointer a,
+               gconstpointer b)
+{
+  gint64 x = *(const gint64 *) a;
+  gint64 y = *(const gint64 *) b;
+
+  return (x > y) - (x < y);
+}
+
+static gint64
+percentile (GArray *sorted,
+            guint   p)
+{
+  if (sorted->len == 0)
+    return 0;
+
+  return g_array_index (sorted, gint64, MIN (sorted->len * p / 100, sorted->len - 1));
+}
+
+static gboolean
+quit_main_loop (gpointer user_data)
+{
+  IndicatorBench *bench = user_data;
+
+  g_main_loop_quit (bench->loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+label_changed (GtkLabel                *label,
+               __attribute__((unused)) GParamSpec *pspec,
+               gpointer                 user_data)
+{
+  IndicatorBench *bench = user_data;
+  gint64 now = g_get_monotonic_time ();
+  const gchar *text = gtk_label_get_label (label);
+  gchar *end;
+  guint64 sequence;
+  gint64 emitted;
+  gint64 latency;
+
+  sequence = g_ascii_strtoull (text, &end, 10);
+  emitted = g_ascii_strtoll (end, NULL, 10);
+  if (sequence == 0 || emitted == 0)
+    return;
+
+  if (bench->first_sequence == 0)
+    bench->first_sequence = sequence;
+  bench->last_sequence = sequence;
+
+  latency = now - emitted;
+  g_array_append_val (bench->latencies, latency);
+}
+
+static void
+entry_added (__attribute__((unused)) IndicatorObject *io,
+             IndicatorObjectEntry    *entry,
+             gpointer                 user_data)
+{
+  IndicatorBench *bench = user_data;
+
+  if (bench->entry)
+    return;
+
+  g_source_remove (bench->startup_timeout_id);
+  bench->startup_timeout_id = 0;
+
+  bench->entry = entry;
+  bench->startup_time = g_get_monotonic_time () - bench->start_time;
+
+  g_signal_connect (entry->label, "notify::label", G_CALLBACK (label_changed), bench);
+  bench->cpu_time = get_cpu_time ();
+  g_timeout_add_seconds (duration, quit_main_loop, bench);
+}
+
+static gboolean
+menu_drawn (__attribute__((unused)) GtkWidget *widget,
+            __attribute__((unused)) cairo_t   *cr,
+            gpointer                           user_data)
+{
+  IndicatorBench *bench = user_data;
+
+  if (bench->menu_time == 0)
+    {
+      bench->menu_time = g_get_monotonic_time () - bench->start_time;
+      g_idle_add (quit_main_loop, bench);
+    }
+
+  return FALSE;
+}
+
+/* Pops the menu up the way a panel would and waits for its first frame */
+static void
+open_menu (IndicatorBench *bench)
+{
+  GtkWidget *window;
+  GdkRectangle rect = { 0, 0, 1, 1 };
+  guint timeout_id;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_widget_show_now (window);
+
+  g_signal_connect_after (bench->entry->menu, "draw", G_CALLBACK (menu_drawn), bench);
+
+  bench->start_time = g_get_monotonic_time ();
+  indicator_object_entry_activate (INDICATOR_OBJECT (bench->indicator), bench->entry, GDK_CURRENT_TIME);
+  gtk_menu_popup_at_rect (bench->entry->menu, gtk_widget_get_window (window), &rect,
+                          GDK_GRAVITY_SOUTH_WEST, GDK_GRAVITY_NORTH_WEST, NULL);
+
+  timeout_id = g_timeout_add_seconds (5, quit_main_loop, bench);
+  g_main_loop_run (bench->loop);
+  if (bench->menu_time)
+    g_source_remove (timeout_id);
+
+  gtk_menu_popdown (bench->entry->menu);
+  gtk_widget_destroy (window);
+}
+
+static gboolean
+write_results (IndicatorBench  *bench,
+               GError         **error)
+{
+  guint64 sent = bench->last_sequence ? bench->last_sequence - bench->first_sequence + 1 : 0;
+  gint64 total = 0;
+  GString *json;
+  gboolean success = TRUE;
+  guint i;
+
+  g_array_sort (bench->latencies, compare_int64);
+  for (i = 0; i < bench->latencies->len; i++)
+    total += g_array_index (bench->latencies, gint64, i);
+
+  json = g_string_new ("{\n");
+  g_string_append_printf (json, "  \"rate\": %d,\n", rate);
+  g_string_append_printf (json, "  \"items\": %d,\n", items);
+  g_string_append_printf (json, "  \"sections\": %d,\n", sections);
+  g_string_append_printf (json, "  \"burst\": %d,\n", burst);
+  g_string_append_printf (json, "  \"lazy_menu\": %s,\n", lazy_menu ? "true" : "false");
+  g_string_append_printf (json, "  \"prewarm_menu\": %s,\n", prewarm_menu ? "true" : "false");
+  g_string_append_printf (json, "  \"coalesce_updates\": %s,\n", coalesce_updates ? "true" : "false");
+  g_string_append_printf (json, "  \"startup_us\": %" G_GINT64_FORMAT ",\n", bench->startup_time);
+  g_string_append_printf (json, "  \"updates\": %u,\n", bench->latencies->len);
+  g_string_append_printf (json, "  \"updates_skipped\": %" G_GUINT64_FORMAT ",\n", sent - bench->latencies->len);
+  g_string_append_printf (json, "  \"latency_us\": { \"min\": %" G_GINT64_FORMAT ", \"mean\": %" G_GINT64_FORMAT
+                          ", \"median\": %" G_GINT64_FORMAT ", \"p95\": %" G_GINT64_FORMAT ", \"max\": %" G_GINT64_FORMAT " },\n",
+                          percentile (bench->latencies, 0),
+                          bench->latencies->len ? total / (gint64) bench->latencies->len : 0,
+                          percentile (bench->latencies, 50),
+                          percentile (bench->latencies, 95),
+                          percentile (bench->latencies, 100));
+  g_string_append_printf (json, "  \"cpu_us_per_update\": %" G_GINT64_FORMAT ",\n",
+                          bench->latencies->len ? bench->cpu_time / (gint64) bench->latencies->len : 0);
+  g_string_append_printf (json, "  \"first_menu_open_us\": %" G_GINT64_FORMAT "\n", bench->menu_time);
+  g_string_append (json, "}\n");
+
+  if (output)
+    success = g_file_set_contents (output, json->str, json->len, error);
+  else
+    g_print ("%s", json->str);
+
+  g_string_free (json, TRUE);
+  return success;
+}
+
+int
+main (int argc, char **argv)
+{
+  IndicatorBench bench = { 0 };
+  GOptionContext *context;
+  GTestDBus *bus;
+  GError *error = NULL;
+  gint status = EXIT_SUCCESS;
+
+  /* see test-indicator-ng.c */
+  g_setenv ("GIO_USE_VFS", "local", TRUE);
+  g_setenv ("GSETTINGS_BACKEND", "memory", TRUE);
+  g_setenv ("NO_AT_BRIDGE", "1", TRUE);
+  g_setenv ("GDK_BACKEND", "x11", TRUE);
+  g_unsetenv ("UBUNTU_MENUPROXY");
+
+  rate = get_env_int ("INDICATOR_BENCH_RATE", rate);
+  items = get_env_int ("INDICATOR_BENCH_ITEMS", items);
+  sections = get_env_int ("INDICATOR_BENCH_SECTIONS", sections);
+  burst = get_env_int ("INDICATOR_BENCH_BURST", burst);
+  burst_interval = get_env_int ("INDICATOR_BENCH_BURST_INTERVAL", burst_interval);
+  duration = get_env_int ("INDICATOR_BENCH_DURATION", duration);
+  lazy_menu = get_env_int ("INDICATOR_BENCH_LAZY_MENU", lazy_menu);
+  prewarm_menu = get_env_int ("INDICATOR_BENCH_PREWARM_MENU", prewarm_menu);
+  coalesce_updates = get_env_int ("INDICATOR_BENCH_COALESCE_UPDATES", coalesce_updates);
+  output = g_strdup (g_getenv ("INDICATOR_BENCH_OUTPUT"));
+
+  context = g_option_context_new ("- benchmark IndicatorNg");
+  g_option_context_add_main_entries (context, options, NULL);
+  g_option_context_add_group (context, gtk_get_option_group (TRUE));
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      g_option_context_free (context);
+      g_free (output);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (context);
+
+  /* the service inherits these through the bus that activates it,
+   * which is why the bench starts a bus of its own */
+  set_env_int ("INDICATOR_BENCH_RATE", rate);
+  set_env_int ("INDICATOR_BENCH_ITEMS", items);
+  set_env_int ("INDICATOR_BENCH_SECTIONS", sections);
+  set_env_int ("INDICATOR_BENCH_BURST", burst);
+  set_env_int ("INDICATOR_BENCH_BURST_INTERVAL", burst_interval);
+
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_add_service_dir (bus, BUILD_DIR);
+  g_test_dbus_up (bus);
+
+  bench.loop = g_main_loop_new (NULL, FALSE);
+  bench.latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  bench.start_time = g_get_monotonic_time ();
+  bench.indicator = indicator_ng_new (SRCDIR "/org.ayatana.indicator.bench", &error);
+  if (bench.indicator == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      status = EXIT_FAILURE;
+      goto out;
+    }
+
+  indicator_ng_set_lazy_menu (bench.indicator, lazy_menu);
+  indicator_ng_set_prewarm_menu (bench.indicator, prewarm_menu);
+  indicator_ng_set_coalesce_updates (bench.indicator, coalesce_updates);
+  g_signal_connect (bench.indicator, INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED, G_CALLBACK (entry_added), &bench);
+
+  /* give up if the service never shows up */
+  bench.startup_timeout_id = g_timeout_add_seconds (10, quit_main_loop, &bench);
+  g_main_loop_run (bench.loop);
+
+  if (bench.entry == NULL)
+    {
+      g_printerr ("the bench indicator didn't show up\n");
+      status = EXIT_FAILURE;
+      goto out;
+    }
+
+  bench.cpu_time = get_cpu_time () - bench.cpu_time;
+  g_signal_handlers_disconnect_by_func (bench.entry->label, label_changed, &bench);
+
+  open_menu (&bench);
+  if (!write_results (&bench, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      status = EXIT_FAILURE;
+    }
+
+out:
+  g_free (output);
+  g_array_unref (bench.latencies);
+  g_clear_object (&bench.indicator);
+  g_main_loop_unref (bench.loop);
+
+  g_test_dbus_down (bus);
+  g_object_unref (bus);
+
+  return status;
+}
@@ -8,8 +8,29 @@ typedef struct
 
   guint actions_export_id;
   guint menu_export_id;
+
+  guint burst_remaining;
+  guint burst_sequence;
+
+  GMainLoop *loop;
 } IndicatorTestService;
 
+static void
+set_header (IndicatorTestService *indicator,
+            const gchar          *label,
+            GVariant             *icon)
+{
+  GVariantBuilder builder;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&builder, "{sv}", "label", g_variant_new_string (label));
+  g_variant_builder_add (&builder, "{sv}", "icon", icon);
+  g_variant_builder_add (&builder, "{sv}", "accessible-desc", g_variant_new_string ("Test indicator"));
+
+  g_action_group_change_action_state (G_ACTION_GROUP (indicator->actions), "_header",
+                                      g_variant_builder_end (&builder));
+}
+
 static void
 bus_acquired (GDBusConnection *connection,
               const gchar     *name,
@@ -63,6 +84,100 @@ activate_show (GSimpleAction *action,
   g_message ("showing");
 }
 
+/* Every header change goes out in its own main loop iteration, the
+ * exported action group would merge them otherwise */
+static gboolean
+emit_burst (gpointer user_data)
+{
+  IndicatorTestService *indicator = user_data;
+  gchar *label;
+
+  label = g_strdup_printf ("Burst %u", ++indicator->burst_sequence);
+  set_header (indicator, label, g_variant_new_string ("indicator-test"));
+  g_free (label);
+
+  return --indicator->burst_remaining > 0 ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+/* Changes the header label to "Burst 1" ... "Burst <n>" in quick
+ * succession */
+static void
+activate_burst (GSimpleAction *action,
+                GVariant      *parameter,
+                gpointer       user_data)
+{
+  IndicatorTestService *indicator = user_data;
+
+  if (indicator->burst_remaining == 0 && g_variant_get_uint32 (parameter) > 0)
+    {
+      indicator->burst_remaining = g_variant_get_uint32 (parameter);
+      indicator->burst_sequence = 0;
+      g_timeout_add (5, emit_burst, indicator);
+    }
+}
+
+/* Changes the header icon to the given theme icon name */
+static void
+activate_set_icon (GSimpleAction *action,
+                   GVariant      *parameter,
+                   gpointer       user_data)
+{
+  IndicatorTestService *indicator = user_data;
+
+  set_header (indicator, "Test", g_variant_new_string (g_variant_get_string (parameter, NULL)));
+}
+
+/* Changes the header icon to the given theme icon name and its
+ * fallbacks, serialized the way real services send icons */
+static void
+activate_set_themed_icon (GSimpleAction *action,
+                          GVariant      *parameter,
+                          gpointer       user_data)
+{
+  IndicatorTestService *indicator = user_data;
+  GIcon *icon;
+  GVariant *serialized;
+
+  icon = g_themed_icon_new_with_default_fallbacks (g_variant_get_string (parameter, NULL));
+  serialized = g_icon_serialize (icon);
+  set_header (indicator, "Test", serialized);
+  g_variant_unref (serialized);
+  g_object_unref (icon);
+}
+
+/* Counts the activations and sums up their deltas in "scroll-log" */
+static void
+activate_scroll (GSimpleAction *action,
+                 GVariant      *parameter,
+                 gpointer       user_data)
+{
+  IndicatorTestService *indicator = user_data;
+  GVariant *state;
+  gint32 count;
+  gint32 sum;
+
+  state = g_action_group_get_action_state (G_ACTION_GROUP (indicator->actions), "scroll-log");
+  g_variant_get (state, "(ii)", &count, &sum);
+  g_variant_unref (state);
+
+  g_action_group_change_action_state (G_ACTION_GROUP (indicator->actions), "scroll-log",
+                                      g_variant_new ("(ii)", count + 1, sum + g_variant_get_int32 (parameter)));
+
+  /* keep the caller waiting for the reply, so that scrolls pile up */
+  g_usleep (300000);
+}
+
+/* Leaves the bus like a crashing service would */
+static void
+activate_quit (GSimpleAction *action,
+               GVariant      *parameter,
+               gpointer       user_data)
+{
+  IndicatorTestService *indicator = user_data;
+
+  g_main_loop_quit (indicator->loop);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -73,17 +188,23 @@ main (int argc, char **argv)
     { "_header", NULL, NULL, "{'label': <'Test'>,"
                              " 'icon': <'indicator-test'>,"
                              " 'accessible-desc': <'Test indicator'> }", NULL },
-    { "show", activate_show, NULL, NULL, NULL }
+    { "show", activate_show, NULL, NULL, NULL },
+    { "burst", activate_burst, "u", NULL, NULL },
+    { "set-icon", activate_set_icon, "s", NULL, NULL },
+    { "set-themed-icon", activate_set_themed_icon, "s", NULL, NULL },
+    { "scroll", activate_scroll, "i", NULL, NULL },
+    { "scroll-log", NULL, NULL, "(0, 0)", NULL },
+    { "quit", activate_quit, NULL, NULL, NULL }
   };
-  GMainLoop *loop;
 
   indicator.actions = g_simple_action_group_new ();
-  g_action_map_add_action_entries(G_ACTION_MAP(indicator.actions), entries, G_N_ELEMENTS (entries), NULL);
+  g_action_map_add_action_entries(G_ACTION_MAP(indicator.actions), entries, G_N_ELEMENTS (entries), &indicator);
 
   submenu = g_menu_new ();
   g_menu_append (submenu, "Show", "indicator.show");
   item = g_menu_item_new (NULL, "indicator._header");
   g_menu_item_set_attribute (item, "x-ayatana-type", "s", "org.ayatana.indicator.root");
+  g_menu_item_set_attribute (item, "x-ayatana-scroll-action", "s", "indicator.scroll");
   g_menu_item_set_submenu (item, G_MENU_MODEL (submenu));
   indicator.menu = g_menu_new ();
   g_menu_append_item (indicator.menu, item);
@@ -97,14 +218,14 @@ main (int argc, char **argv)
                   &indicator,
                   NULL);
 
-  loop = g_main_loop_new (NULL, FALSE);
-  g_main_loop_run (loop);
+  indicator.loop = g_main_loop_new (NULL, FALSE);
+  g_main_loop_run (indicator.loop);
 
   g_object_unref (submenu);
   g_object_unref (item);
   g_object_unref (indicator.actions);
   g_object_unref (indicator.menu);
-  g_object_unref (loop);
+  g_main_loop_unref (indicator.loop);
 
   return 0;
 }
@@ -63,6 +63,20 @@ set_label_fixed (GtkLabel *label, guint nPadding, GtkCssProvider **cached)
     g_free (sCss);
 }
 
+/*
+ * Simulate what indicator_ng_set_label does now: both padding states
+ * live in one shared provider and only a style class is toggled.
+ */
+static void
+set_label_classes (GtkLabel *label, guint nPadding)
+{
+    GtkStyleContext *pStyleContext = gtk_widget_get_style_context (GTK_WIDGET (label));
+    gboolean bPadded = nPadding > 0;
+
+    gtk_style_context_remove_class (pStyleContext, bPadded ? "indicator-ng-label-unpadded" : "indicator-ng-label-padded");
+    gtk_style_context_add_class (pStyleContext, bPadded ? "indicator-ng-label-padded" : "indicator-ng-label-unpadded");
+}
+
 #define ITERATIONS 100000
 
 static void
@@ -116,6 +130,38 @@ test_fixed_set_label (void)
     g_object_unref (label);
 }
 
+static void
+test_shared_provider_set_label (void)
+{
+    GtkWidget *label = gtk_label_new ("12:00:00");
+    g_object_ref_sink (label);
+
+    GtkCssProvider *shared = gtk_css_provider_new ();
+    gtk_css_provider_load_from_data (shared, "label.indicator-ng-label-unpadded{padding-left: 0px;} label.indicator-ng-label-padded{padding-left: 6px;}", -1, NULL);
+    gtk_style_context_add_provider (gtk_widget_get_style_context (label), GTK_STYLE_PROVIDER (shared),
+                                    GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
+    long rss_before = get_rss_kb ();
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        set_label_classes (GTK_LABEL (label), (i % 2) * 6);
+    }
+
+    long rss_after = get_rss_kb ();
+    long growth_kb = rss_after - rss_before;
+
+    g_test_message ("shared: RSS before=%ld KB, after=%ld KB, growth=%ld KB over %d iterations",
+                    rss_before, rss_after, growth_kb, ITERATIONS);
+
+    /* Toggling classes must not allocate anything that sticks around. */
+    g_assert_cmpint (growth_kb, <, 5000);
+    g_assert (gtk_style_context_has_class (gtk_widget_get_style_context (label), "indicator-ng-label-padded"));
+    g_assert (!gtk_style_context_has_class (gtk_widget_get_style_context (label), "indicator-ng-label-unpadded"));
+
+    g_object_unref (shared);
+    g_object_unref (label);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -123,6 +169,7 @@ main (int argc, char **argv)
 
     g_test_add_func ("/indicator-ng/css-provider-leak/leaky", test_leaky_set_label);
     g_test_add_func ("/indicator-ng/css-provider-leak/fixed", test_fixed_set_label);
+    g_test_add_func ("/indicator-ng/css-provider-leak/shared", test_shared_provider_set_label);
 
     return g_test_run ();
 }
@@ -1,5 +1,6 @@
 
 #include "indicator-ng.h"
+#include <glib/gstdio.h>
 
 static void
 indicator_ng_test_func (gconstpointer user_data)
@@ -95,7 +96,143 @@ test_instantiation_with_profile (void)
 
   g_assert_cmpstr (indicator_ng_get_profile (indicator), ==, "greeter");
 
+  {
+    guint restart_count;
+    guint recent_restarts;
+    guint restart_backoff;
+
+    g_object_get (indicator, "restart-count", &restart_count,
+                             "recent-restarts", &recent_restarts,
+                             "restart-backoff", &restart_backoff,
+                             NULL);
+
+    g_assert_cmpuint (restart_count, ==, 0);
+    g_assert_cmpuint (recent_restarts, ==, 0);
+    g_assert_cmpuint (restart_backoff, >, 0);
+  }
+
+  g_object_unref (indicator);
+}
+
+static void
+instantiated (__attribute__((unused)) GObject *source,
+              GAsyncResult *result,
+              gpointer      user_data)
+{
+  GAsyncResult **out = user_data;
+
+  *out = g_object_ref (result);
+}
+
+static void
+test_instantiation_async (void)
+{
+  IndicatorNg *indicator;
+  GAsyncResult *result = NULL;
+  GError *error = NULL;
+
+  indicator_ng_new_for_profile_async (SRCDIR "/org.ayatana.indicator.test", "greeter",
+                                      NULL, instantiated, &result);
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  indicator = indicator_ng_new_for_profile_finish (result, &error);
+  g_assert (indicator);
+  g_assert (error == NULL);
+
+  g_assert_cmpstr (indicator_ng_get_service_file (indicator), ==, SRCDIR "/org.ayatana.indicator.test");
+  g_assert_cmpstr (indicator_ng_get_profile (indicator), ==, "greeter");
+
+  g_clear_object (&result);
+  g_object_unref (indicator);
+
+  indicator_ng_new_for_profile_async (SRCDIR "/org.ayatana.does.not.exist.indicator", "desktop",
+                                      NULL, instantiated, &result);
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  indicator = indicator_ng_new_for_profile_finish (result, &error);
+  g_assert (indicator == NULL);
+  g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+
+  g_clear_error (&error);
+  g_object_unref (result);
+}
+
+static void
+test_index (void)
+{
+  IndicatorNgIndex *index;
+  const IndicatorNgIndexRecord *record;
+  IndicatorNg *indicator;
+  GError *error = NULL;
+  GMainLoop *loop;
+  GList *entries;
+  gchar *service_dir;
+  gchar *cache_dir;
+  gchar *cache_file;
+  gchar *service_file;
+  gchar *contents;
+
+  service_dir = g_dir_make_tmp ("indicator-ng-index-XXXXXX", &error);
+  g_assert_no_error (error);
+  cache_dir = g_dir_make_tmp ("indicator-ng-cache-XXXXXX", &error);
+  g_assert_no_error (error);
+  cache_file = g_build_filename (cache_dir, "index", NULL);
+
+  g_file_get_contents (SRCDIR "/org.ayatana.indicator.test", &contents, NULL, &error);
+  g_assert_no_error (error);
+  service_file = g_build_filename (service_dir, "org.ayatana.indicator.test", NULL);
+  g_file_set_contents (service_file, contents, -1, &error);
+  g_assert_no_error (error);
+  g_free (contents);
+
+  index = indicator_ng_index_new (service_dir, cache_file, &error);
+  g_assert_no_error (error);
+  g_assert (!indicator_ng_index_is_cached (index));
+  g_assert (g_file_test (cache_file, G_FILE_TEST_IS_REGULAR));
+  g_assert_cmpuint (indicator_ng_index_get_n_records (index), ==, 1);
+  indicator_ng_index_free (index);
+
+  /* the second time, everything comes from the cache */
+  index = indicator_ng_index_new (service_dir, cache_file, &error);
+  g_assert_no_error (error);
+  g_assert (indicator_ng_index_is_cached (index));
+  g_assert_cmpuint (indicator_ng_index_get_n_records (index), ==, 1);
+
+  g_assert (indicator_ng_index_lookup (index, "org.ayatana.indicator.test", "greeter") == NULL);
+  record = indicator_ng_index_lookup (index, "org.ayatana.indicator.test", "desktop");
+  g_assert (record == indicator_ng_index_get_record (index, 0));
+  g_assert_cmpstr (record->service_file, ==, service_file);
+  g_assert_cmpstr (record->name, ==, "indicator-test");
+  g_assert_cmpstr (record->object_path, ==, "/org/ayatana/indicator/test");
+  g_assert_cmpstr (record->menu_object_path, ==, "/org/ayatana/indicator/test/desktop");
+  g_assert_cmpint (record->position, ==, -1);
+
+  indicator = indicator_ng_new_from_index_record (record);
+  g_assert_cmpstr (indicator_ng_get_service_file (indicator), ==, service_file);
+  g_assert_cmpstr (indicator_ng_get_profile (indicator), ==, "desktop");
+  indicator_ng_index_free (index);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+  g_list_free (entries);
+
+  g_main_loop_unref (loop);
   g_object_unref (indicator);
+
+  g_unlink (cache_file);
+  g_unlink (service_file);
+  g_rmdir (cache_dir);
+  g_rmdir (service_dir);
+  g_free (service_file);
+  g_free (cache_file);
+  g_free (cache_dir);
+  g_free (service_dir);
 }
 
 /* From gtk+/testsuite/gtk/gtkmenu.c
@@ -171,6 +308,885 @@ test_menu (void)
   g_object_unref (indicator);
 }
 
+/* Like get_label(), but returns the GtkLabel itself */
+static GtkLabel *
+find_label (GtkMenuItem *item)
+{
+  GList *children = gtk_container_get_children (GTK_CONTAINER (item));
+  GtkLabel *label = NULL;
+
+  while (children)
+    {
+      if (GTK_IS_CONTAINER (children->data))
+        children = g_list_concat (children, gtk_container_get_children (children->data));
+      else if (GTK_IS_LABEL (children->data))
+        label = children->data;
+
+      children = g_list_delete_link (children, children);
+    }
+
+  return label;
+}
+
+static void
+test_menu_item_resize (void)
+{
+  IndicatorNg *indicator;
+  GError *error = NULL;
+  GMainLoop *loop;
+  GList *entries;
+  IndicatorObjectEntry *entry;
+  GList *children;
+  GtkWidget *window;
+  GdkWindow *menu_window;
+  GdkRectangle rect = { 0, 0, 1, 1 };
+  GtkLabel *label;
+  gint width;
+
+  indicator = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert (indicator);
+  g_assert (error == NULL);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+  entry = entries->data;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_widget_show_now (window);
+  gtk_menu_popup_at_rect (entry->menu, gtk_widget_get_window (window), &rect,
+                          GDK_GRAVITY_SOUTH_WEST, GDK_GRAVITY_NORTH_WEST, NULL);
+
+  g_timeout_add (200, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  menu_window = gtk_widget_get_window (gtk_widget_get_toplevel (GTK_WIDGET (entry->menu)));
+  g_assert (menu_window != NULL);
+  width = gdk_window_get_width (menu_window);
+
+  /* a change inside the item, as an IDO makes it, without anything
+   * being notified on the item itself */
+  children = gtk_container_get_children (GTK_CONTAINER (entry->menu));
+  g_assert_cmpint (g_list_length (children), ==, 1);
+  label = find_label (children->data);
+  g_assert (label != NULL);
+  gtk_label_set_text (label, "Show a label that is a lot wider than the one before");
+  g_list_free (children);
+
+  g_timeout_add (200, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  g_assert_cmpint (gdk_window_get_width (menu_window), >, width);
+
+  gtk_menu_popdown (entry->menu);
+  gtk_widget_destroy (window);
+
+  g_list_free (entries);
+  g_main_loop_unref (loop);
+  g_object_unref (indicator);
+}
+
+static void
+test_lazy_menu (void)
+{
+  IndicatorNg *indicator;
+  GError *error = NULL;
+  GMainLoop *loop;
+  GList *entries;
+  IndicatorObjectEntry *entry;
+  GList *children;
+
+  indicator = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert (indicator);
+  g_assert (error == NULL);
+
+  indicator_ng_set_lazy_menu (indicator, TRUE);
+  g_assert (indicator_ng_get_lazy_menu (indicator));
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+
+  /* the header is there, the popup isn't fetched yet */
+  entry = entries->data;
+  g_assert_cmpstr (gtk_label_get_label (entry->label), ==, "Test");
+  children = gtk_container_get_children (GTK_CONTAINER (entry->menu));
+  g_assert_cmpint (g_list_length (children), ==, 0);
+  g_list_free (children);
+
+  indicator_object_entry_pointer_enter (INDICATOR_OBJECT (indicator), entry);
+
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  children = gtk_container_get_children (GTK_CONTAINER (entry->menu));
+  g_assert_cmpint (g_list_length (children), ==, 1);
+  g_assert_cmpstr (get_label (children->data), ==, "Show");
+  g_list_free (children);
+
+  g_list_free (entries);
+  g_main_loop_unref (loop);
+  g_object_unref (indicator);
+}
+
+static void
+test_prewarm_menu (void)
+{
+  IndicatorNg *indicator;
+  GError *error = NULL;
+  GMainLoop *loop;
+  GList *entries;
+  IndicatorObjectEntry *entry;
+  GList *children;
+
+  indicator = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert (indicator);
+  g_assert (error == NULL);
+
+  indicator_ng_set_prewarm_menu (indicator, TRUE);
+  g_assert (indicator_ng_get_prewarm_menu (indicator));
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+
+  /* the popup was built and realized without being shown */
+  entry = entries->data;
+  g_assert (gtk_widget_get_realized (GTK_WIDGET (entry->menu)));
+  g_assert (!gtk_widget_get_visible (GTK_WIDGET (entry->menu)));
+  children = gtk_container_get_children (GTK_CONTAINER (entry->menu));
+  g_assert_cmpint (g_list_length (children), ==, 1);
+  g_list_free (children);
+
+  g_list_free (entries);
+  g_main_loop_unref (loop);
+  g_object_unref (indicator);
+}
+
+/* Asks the test service to change the header label to "Burst 1" ...
+ * "Burst <n>", each change in a D-Bus message of its own */
+static void
+request_header_burst (IndicatorObjectEntry *entry,
+                      guint                 n)
+{
+  GActionGroup *actions = gtk_widget_get_action_group (GTK_WIDGET (entry->menu), "indicator");
+
+  g_assert (actions != NULL);
+  g_action_group_activate_action (actions, "burst", g_variant_new_uint32 (n));
+}
+
+static void
+test_coalesce_updates (void)
+{
+  IndicatorNg *indicator;
+  GError *error = NULL;
+  GMainLoop *loop;
+  GList *entries;
+  IndicatorObjectEntry *entry;
+  gboolean coalesce;
+  guint merged;
+
+  indicator = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert (indicator);
+  g_assert (error == NULL);
+
+  g_assert (!indicator_ng_get_coalesce_updates (indicator));
+  g_object_set (indicator, "coalesce-updates", TRUE, NULL);
+  g_object_get (indicator, "coalesce-updates", &coalesce, NULL);
+  g_assert (coalesce);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  /* the header must still be applied, just not more than once per frame */
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+
+  entry = entries->data;
+  g_assert_cmpstr (gtk_label_get_label (entry->label), ==, "Test");
+  g_assert_cmpstr (entry->accessible_desc, ==, "Test indicator");
+
+  /* let the whole burst queue up before the main loop gets to it, then
+   * it has to be applied once, with the last label */
+  g_assert_cmpuint (indicator_ng_get_merged_updates (indicator), ==, 0);
+  request_header_burst (entry, 5);
+  g_usleep (300000);
+
+  g_timeout_add (200, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  g_object_get (indicator, "merged-updates", &merged, NULL);
+  g_assert_cmpuint (merged, >, 0);
+  g_assert_cmpstr (gtk_label_get_label (entry->label), ==, "Burst 5");
+
+  indicator_ng_set_coalesce_updates (indicator, FALSE);
+  g_assert (!indicator_ng_get_coalesce_updates (indicator));
+
+  g_list_free (entries);
+  g_main_loop_unref (loop);
+  g_object_unref (indicator);
+}
+
+static void
+test_max_update_rate (void)
+{
+  IndicatorNg *indicator;
+  GError *error = NULL;
+  GMainLoop *loop;
+  GList *entries;
+  IndicatorObjectEntry *entry;
+
+  indicator = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert (indicator);
+  g_assert (error == NULL);
+
+  /* not limited by the service file */
+  g_assert_cmpuint (indicator_ng_get_max_update_rate (indicator), ==, 0);
+  indicator_ng_set_max_update_rate (indicator, 1);
+  g_assert_cmpuint (indicator_ng_get_max_update_rate (indicator), ==, 1);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (1500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+
+  entry = entries->data;
+  g_assert_cmpstr (gtk_label_get_label (entry->label), ==, "Test");
+  g_assert_cmpstr (entry->accessible_desc, ==, "Test indicator");
+
+  /* the first change of the burst goes through, the second one waits
+   * for the end of the interval and the others are dropped */
+  g_assert_cmpuint (indicator_ng_get_dropped_updates (indicator), ==, 0);
+  request_header_burst (entry, 5);
+
+  g_timeout_add (300, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  g_assert_cmpuint (indicator_ng_get_dropped_updates (indicator), >, 0);
+  g_assert_cmpstr (gtk_label_get_label (entry->label), !=, "Burst 5");
+
+  /* whatever was dropped, the final state is applied */
+  g_timeout_add (1200, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  g_assert_cmpstr (gtk_label_get_label (entry->label), ==, "Burst 5");
+
+  g_list_free (entries);
+  g_main_loop_unref (loop);
+  g_object_unref (indicator);
+}
+
+static void
+scroll_entry (IndicatorNg          *indicator,
+              IndicatorObjectEntry *entry)
+{
+  g_signal_emit_by_name (indicator, INDICATOR_OBJECT_SIGNAL_ENTRY_SCROLLED,
+                         entry, 1, INDICATOR_OBJECT_SCROLL_UP);
+}
+
+/* How many scroll activations the test service got, and the sum of
+ * their deltas */
+static void
+get_scroll_log (IndicatorObjectEntry *entry,
+                gint                 *count,
+                gint                 *sum)
+{
+  GActionGroup *actions = gtk_widget_get_action_group (GTK_WIDGET (entry->menu), "indicator");
+  GVariant *state;
+
+  g_assert (actions != NULL);
+  state = g_action_group_get_action_state (actions, "scroll-log");
+  g_assert (state != NULL);
+  g_variant_get (state, "(ii)", count, sum);
+  g_variant_unref (state);
+}
+
+static void
+test_max_scrolls_in_flight (void)
+{
+  IndicatorNg *indicator;
+  GError *error = NULL;
+  GMainLoop *loop;
+  GList *entries;
+  IndicatorObjectEntry *entry;
+  guint max;
+  gint count;
+  gint sum;
+
+  indicator = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert (indicator);
+  g_assert (error == NULL);
+
+  g_assert_cmpuint (indicator_ng_get_max_scrolls_in_flight (indicator), ==, 0);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+  entry = entries->data;
+
+  /* scrolls within one frame are sent as a single activation */
+  scroll_entry (indicator, entry);
+  scroll_entry (indicator, entry);
+  scroll_entry (indicator, entry);
+
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  get_scroll_log (entry, &count, &sum);
+  g_assert_cmpint (count, ==, 1);
+  g_assert_cmpint (sum, ==, 3);
+
+  g_object_set (indicator, "max-scrolls-in-flight", 1, NULL);
+  g_object_get (indicator, "max-scrolls-in-flight", &max, NULL);
+  g_assert_cmpuint (max, ==, 1);
+
+  /* the service takes its time to reply, scrolls in later frames wait
+   * for that and are then sent together */
+  scroll_entry (indicator, entry);
+  g_timeout_add (100, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  scroll_entry (indicator, entry);
+  g_timeout_add (50, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  scroll_entry (indicator, entry);
+  g_timeout_add (1000, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  get_scroll_log (entry, &count, &sum);
+  g_assert_cmpint (count, ==, 3);
+  g_assert_cmpint (sum, ==, 6);
+
+  g_list_free (entries);
+  g_main_loop_unref (loop);
+  g_object_unref (indicator);
+}
+
+static void
+test_shared_proxies (void)
+{
+  IndicatorNg *indicator;
+  IndicatorNg *other;
+  GError *error = NULL;
+  GMainLoop *loop;
+  GList *entries;
+  GList *other_entries;
+  IndicatorObjectEntry *entry;
+  IndicatorObjectEntry *other_entry;
+
+  indicator = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert_no_error (error);
+  other = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert_no_error (error);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  other_entries = indicator_object_get_entries (INDICATOR_OBJECT (other));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+  g_assert_cmpint (g_list_length (other_entries), ==, 1);
+
+  /* both got the service, through the same action group */
+  entry = entries->data;
+  other_entry = other_entries->data;
+  g_assert_cmpstr (gtk_label_get_label (entry->label), ==, "Test");
+  g_assert_cmpstr (gtk_label_get_label (other_entry->label), ==, "Test");
+  g_assert (gtk_widget_get_action_group (GTK_WIDGET (entry->menu), "indicator") ==
+            gtk_widget_get_action_group (GTK_WIDGET (other_entry->menu), "indicator"));
+
+  g_list_free (entries);
+  g_list_free (other_entries);
+  g_object_unref (other);
+
+  /* the remaining one keeps working without the other */
+  g_timeout_add (200, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+
+  g_list_free (entries);
+  g_main_loop_unref (loop);
+  g_object_unref (indicator);
+}
+
+static void
+test_connection (void)
+{
+  IndicatorNg *indicator;
+  IndicatorNg *other;
+  GDBusConnection *connection;
+  GError *error = NULL;
+  GMainLoop *loop;
+  gchar *address;
+  GList *entries;
+  GList *other_entries;
+  IndicatorObjectEntry *entry;
+  IndicatorObjectEntry *other_entry;
+
+  address = g_dbus_address_get_for_bus_sync (G_BUS_TYPE_SESSION, NULL, &error);
+  g_assert_no_error (error);
+  connection = g_dbus_connection_new_for_address_sync (address,
+                                                       G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                       G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                       NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  indicator = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert_no_error (error);
+  other = g_initable_new (INDICATOR_TYPE_NG, NULL, &error,
+                          "service-file", SRCDIR "/org.ayatana.indicator.test",
+                          "connection", connection,
+                          NULL);
+  g_assert_no_error (error);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  other_entries = indicator_object_get_entries (INDICATOR_OBJECT (other));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+  g_assert_cmpint (g_list_length (other_entries), ==, 1);
+
+  /* both got the service, each through its own connection */
+  entry = entries->data;
+  other_entry = other_entries->data;
+  g_assert_cmpstr (gtk_label_get_label (entry->label), ==, "Test");
+  g_assert_cmpstr (gtk_label_get_label (other_entry->label), ==, "Test");
+  g_assert (gtk_widget_get_action_group (GTK_WIDGET (entry->menu), "indicator") !=
+            gtk_widget_get_action_group (GTK_WIDGET (other_entry->menu), "indicator"));
+
+  /* the other connection going away doesn't affect the session bus */
+  g_list_free (other_entries);
+  g_object_unref (other);
+  g_dbus_connection_close_sync (connection, NULL, NULL);
+  g_object_unref (connection);
+
+  g_timeout_add (200, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  g_assert_cmpstr (gtk_label_get_label (entry->label), ==, "Test");
+  g_assert (gtk_widget_get_action_group (GTK_WIDGET (entry->menu), "indicator") != NULL);
+
+  g_list_free (entries);
+  g_main_loop_unref (loop);
+  g_object_unref (indicator);
+  g_free (address);
+}
+
+static void
+test_headless (void)
+{
+  IndicatorNg *indicator;
+  GError *error = NULL;
+  GMainLoop *loop;
+  GList *entries;
+  IndicatorObjectEntry *entry;
+  GIcon *icon;
+
+  indicator = indicator_ng_new_headless (SRCDIR "/org.ayatana.indicator.test", "desktop", &error);
+  g_assert_no_error (error);
+  g_assert (indicator_ng_get_headless (indicator));
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  /* no widgets, only the state */
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+  entry = entries->data;
+  g_assert (entry->label == NULL);
+  g_assert (entry->image == NULL);
+  g_assert (entry->menu == NULL);
+
+  g_assert (indicator_ng_get_visible (indicator));
+  g_assert_cmpstr (indicator_ng_get_label (indicator), ==, "Test");
+  g_assert_cmpstr (indicator_ng_get_accessible_desc (indicator), ==, "Test indicator");
+
+  icon = indicator_ng_get_icon (indicator);
+  g_assert (G_IS_THEMED_ICON (icon));
+  g_assert_cmpstr (g_themed_icon_get_names (G_THEMED_ICON (icon))[0], ==, "indicator-test");
+
+  g_assert (G_IS_MENU_MODEL (indicator_ng_get_menu_model (indicator)));
+
+  g_list_free (entries);
+  g_main_loop_unref (loop);
+  g_object_unref (indicator);
+}
+
+/* Returns the service's action group once it is on the bus */
+static GActionGroup *
+wait_for_service (IndicatorObjectEntry *entry,
+                  GMainLoop            *loop)
+{
+  guint i;
+
+  for (i = 0; i < 100; i++)
+    {
+      GActionGroup *actions = gtk_widget_get_action_group (GTK_WIDGET (entry->menu), "indicator");
+
+      if (actions && g_action_group_has_action (actions, "quit"))
+        return actions;
+
+      g_timeout_add (50, stop_main_loop, loop);
+      g_main_loop_run (loop);
+    }
+
+  g_assert_not_reached ();
+  return NULL;
+}
+
+/* Runs the main loop until @indicator restarted its service @count
+ * times in total, for at most @timeout milliseconds */
+static gboolean
+wait_for_restart (IndicatorNg *indicator,
+                  GMainLoop   *loop,
+                  guint        count,
+                  guint        timeout)
+{
+  guint restart_count;
+  guint waited;
+
+  for (waited = 0; ; waited += 50)
+    {
+      g_object_get (indicator, "restart-count", &restart_count, NULL);
+      if (restart_count >= count || waited >= timeout)
+        break;
+
+      g_timeout_add (50, stop_main_loop, loop);
+      g_main_loop_run (loop);
+    }
+
+  return restart_count >= count;
+}
+
+static void
+test_restart (void)
+{
+  IndicatorNg *indicator;
+  GError *error = NULL;
+  GMainLoop *loop;
+  GList *entries;
+  IndicatorObjectEntry *entry;
+  guint recent_restarts;
+  guint restart_backoff;
+  guint i;
+
+  g_setenv ("INDICATOR_NG_RESTART_BACKOFF", "100", TRUE);
+  g_setenv ("INDICATOR_NG_RESTART_COOLDOWN", "2", TRUE);
+
+  indicator = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert (indicator);
+  g_assert (error == NULL);
+
+  g_unsetenv ("INDICATOR_NG_RESTART_BACKOFF");
+  g_unsetenv ("INDICATOR_NG_RESTART_COOLDOWN");
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+  entry = entries->data;
+
+  g_object_get (indicator, "restart-backoff", &restart_backoff, NULL);
+  g_assert_cmpuint (restart_backoff, ==, 100);
+
+  /* the backoff doubles with every restart */
+  for (i = 1; i <= 5; i++)
+    {
+      g_action_group_activate_action (wait_for_service (entry, loop), "quit", NULL);
+      g_assert (wait_for_restart (indicator, loop, i, 5000));
+
+      g_object_get (indicator, "recent-restarts", &recent_restarts,
+                               "restart-backoff", &restart_backoff,
+                               NULL);
+      g_assert_cmpuint (recent_restarts, ==, i);
+      g_assert_cmpuint (restart_backoff, ==, 100 << i);
+    }
+
+  /* the budget is spent: nothing happens until the cooldown is over,
+   * then the service gets one more chance */
+  g_test_expect_message (NULL, G_LOG_LEVEL_WARNING, "*vanished 5 times*");
+  g_action_group_activate_action (wait_for_service (entry, loop), "quit", NULL);
+  g_assert (!wait_for_restart (indicator, loop, 6, 500));
+  g_test_assert_expected_messages ();
+  g_assert (wait_for_restart (indicator, loop, 6, 5000));
+
+  /* which, when it fails, means waiting for the whole cooldown again */
+  g_action_group_activate_action (wait_for_service (entry, loop), "quit", NULL);
+  g_assert (!wait_for_restart (indicator, loop, 7, 500));
+  g_assert (wait_for_restart (indicator, loop, 7, 5000));
+
+  g_object_get (indicator, "restart-backoff", &restart_backoff, NULL);
+  g_assert_cmpuint (restart_backoff, ==, 100 << 5);
+
+  wait_for_service (entry, loop);
+
+  g_list_free (entries);
+  g_main_loop_unref (loop);
+  g_object_unref (indicator);
+}
+
+static void
+test_shared_restart (void)
+{
+  IndicatorNg *indicator;
+  IndicatorNg *other;
+  GError *error = NULL;
+  GMainLoop *loop;
+  GList *entries;
+  IndicatorObjectEntry *entry;
+  guint restart_count;
+
+  g_setenv ("INDICATOR_NG_RESTART_BACKOFF", "100", TRUE);
+
+  indicator = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert_no_error (error);
+  other = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert_no_error (error);
+
+  g_unsetenv ("INDICATOR_NG_RESTART_BACKOFF");
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+  entry = entries->data;
+
+  /* a crash restarts the service once, not once per indicator */
+  g_action_group_activate_action (wait_for_service (entry, loop), "quit", NULL);
+  g_assert (wait_for_restart (indicator, loop, 1, 5000));
+  g_assert (!wait_for_restart (indicator, loop, 2, 500));
+
+  g_object_get (other, "restart-count", &restart_count, NULL);
+  g_assert_cmpuint (restart_count, ==, 1);
+
+  wait_for_service (entry, loop);
+
+  g_list_free (entries);
+  g_main_loop_unref (loop);
+  g_object_unref (other);
+  g_object_unref (indicator);
+}
+
+static void
+write_test_icon (const gchar *dir,
+                 const gchar *name,
+                 guint32      color)
+{
+  GdkPixbuf *pixbuf;
+  gchar *path;
+
+  /* smaller than the panel size, so it is rendered from the file */
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, 16, 16);
+  gdk_pixbuf_fill (pixbuf, color);
+
+  path = g_strdup_printf ("%s/%s.png", dir, name);
+  g_assert (gdk_pixbuf_save (pixbuf, path, "png", NULL, NULL));
+
+  g_free (path);
+  g_object_unref (pixbuf);
+}
+
+static void
+remove_test_icon (const gchar *dir,
+                  const gchar *name)
+{
+  gchar *path;
+
+  path = g_strdup_printf ("%s/%s.png", dir, name);
+  g_unlink (path);
+  g_free (path);
+}
+
+static void
+set_header_icon (IndicatorNg          *indicator,
+                 IndicatorObjectEntry *entry,
+                 GMainLoop            *loop,
+                 const gchar          *name)
+{
+  GActionGroup *actions = gtk_widget_get_action_group (GTK_WIDGET (entry->menu), "indicator");
+  GIcon *icon;
+
+  g_assert (actions != NULL);
+  g_action_group_activate_action (actions, "set-icon", g_variant_new_string (name));
+
+  g_timeout_add (200, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  icon = indicator_ng_get_icon (indicator);
+  g_assert (G_IS_THEMED_ICON (icon));
+  g_assert_cmpstr (g_themed_icon_get_names (G_THEMED_ICON (icon))[0], ==, name);
+}
+
+static void
+set_header_themed_icon (IndicatorNg          *indicator,
+                        IndicatorObjectEntry *entry,
+                        GMainLoop            *loop,
+                        const gchar          *name)
+{
+  GActionGroup *actions = gtk_widget_get_action_group (GTK_WIDGET (entry->menu), "indicator");
+  GIcon *icon;
+
+  g_assert (actions != NULL);
+  g_action_group_activate_action (actions, "set-themed-icon", g_variant_new_string (name));
+
+  g_timeout_add (200, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  icon = indicator_ng_get_icon (indicator);
+  g_assert (G_IS_THEMED_ICON (icon));
+  g_assert_cmpstr (g_themed_icon_get_names (G_THEMED_ICON (icon))[0], ==, name);
+  g_assert_cmpuint (g_strv_length ((gchar **) g_themed_icon_get_names (G_THEMED_ICON (icon))), >, 1);
+}
+
+static guint
+get_stat (IndicatorNg *indicator,
+          const gchar *key)
+{
+  GVariant *stats;
+  guint value;
+
+  stats = indicator_object_get_stats (INDICATOR_OBJECT (indicator));
+  g_assert (g_variant_lookup (stats, key, "u", &value));
+  g_variant_unref (stats);
+
+  return value;
+}
+
+static void
+test_icon_cache (void)
+{
+  IndicatorNg *indicator;
+  GError *error = NULL;
+  GMainLoop *loop;
+  GList *entries;
+  IndicatorObjectEntry *entry;
+  gchar *dir;
+  guint reloads;
+  guint hits;
+
+  dir = g_dir_make_tmp ("test-indicator-ng-XXXXXX", &error);
+  g_assert_no_error (error);
+  write_test_icon (dir, "indicator-test-cache-a", 0xff0000ff);
+  write_test_icon (dir, "indicator-test-cache-b", 0x00ff00ff);
+  gtk_icon_theme_append_search_path (gtk_icon_theme_get_default (), dir);
+
+  indicator = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert (indicator);
+  g_assert (error == NULL);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  entries = indicator_object_get_entries (INDICATOR_OBJECT (indicator));
+  g_assert_cmpint (g_list_length (entries), ==, 1);
+  entry = entries->data;
+
+  set_header_icon (indicator, entry, loop, "indicator-test-cache-a");
+  g_assert (gtk_image_get_storage_type (entry->image) == GTK_IMAGE_PIXBUF);
+
+  /* an icon shown again isn't deserialized again */
+  set_header_icon (indicator, entry, loop, "indicator-test-cache-b");
+  reloads = get_stat (indicator, "icon-reloads");
+  hits = get_stat (indicator, "icon-cache-hits");
+  set_header_icon (indicator, entry, loop, "indicator-test-cache-a");
+  g_assert_cmpuint (get_stat (indicator, "icon-reloads"), ==, reloads);
+  g_assert_cmpuint (get_stat (indicator, "icon-cache-hits"), ==, hits + 1);
+
+  /* but it is rendered again, for this image and the current theme */
+  g_assert (gtk_image_get_storage_type (entry->image) == GTK_IMAGE_PIXBUF);
+  g_signal_emit_by_name (gtk_icon_theme_get_default (), "changed");
+  set_header_icon (indicator, entry, loop, "indicator-test-cache-b");
+  g_assert_cmpuint (get_stat (indicator, "icon-cache-hits"), ==, hits + 2);
+
+  /* icons serialized with g_icon_serialize() are (sv) containers, they
+     are cached just the same, without criticals from hashing them */
+  set_header_themed_icon (indicator, entry, loop, "indicator-test-cache-a");
+  set_header_themed_icon (indicator, entry, loop, "indicator-test-cache-b");
+  reloads = get_stat (indicator, "icon-reloads");
+  hits = get_stat (indicator, "icon-cache-hits");
+  set_header_themed_icon (indicator, entry, loop, "indicator-test-cache-a");
+  set_header_themed_icon (indicator, entry, loop, "indicator-test-cache-b");
+  g_assert_cmpuint (get_stat (indicator, "icon-reloads"), ==, reloads);
+  g_assert_cmpuint (get_stat (indicator, "icon-cache-hits"), ==, hits + 2);
+
+  g_list_free (entries);
+  g_main_loop_unref (loop);
+  g_object_unref (indicator);
+
+  remove_test_icon (dir, "indicator-test-cache-a");
+  remove_test_icon (dir, "indicator-test-cache-b");
+  g_rmdir (dir);
+  g_free (dir);
+}
+
+static void
+test_stats (void)
+{
+  IndicatorNg *indicator;
+  GError *error = NULL;
+  GMainLoop *loop;
+  GVariant *stats;
+  GVariant *handler_time;
+  guint32 count;
+  gint64 time;
+
+  indicator = indicator_ng_new (SRCDIR "/org.ayatana.indicator.test", &error);
+  g_assert_no_error (error);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (500, stop_main_loop, loop);
+  g_main_loop_run (loop);
+
+  stats = indicator_object_get_stats (INDICATOR_OBJECT (indicator));
+  g_assert (g_variant_is_of_type (stats, G_VARIANT_TYPE_VARDICT));
+
+  g_assert (g_variant_lookup (stats, "entries", "u", &count));
+  g_assert_cmpuint (count, ==, 1);
+  g_assert (g_variant_lookup (stats, "header-updates", "u", &count));
+  g_assert_cmpuint (count, >=, 1);
+  g_assert (g_variant_lookup (stats, "restarts", "u", &count));
+  g_assert_cmpuint (count, ==, 0);
+  g_assert (g_variant_lookup (stats, "last-restart", "x", &time));
+  g_assert_cmpint (time, ==, 0);
+
+  handler_time = g_variant_lookup_value (stats, "handler-time", G_VARIANT_TYPE ("a{sx}"));
+  g_assert (handler_time);
+  g_assert (g_variant_lookup (handler_time, "update-entry", "x", &time));
+  g_assert_cmpint (time, >=, 0);
+
+  g_variant_unref (handler_time);
+  g_variant_unref (stats);
+  g_main_loop_unref (loop);
+  g_object_unref (indicator);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -189,7 +1205,22 @@ main (int argc, char **argv)
   indicator_ng_test_add ("non-existing", test_non_existing);
   indicator_ng_test_add ("instantiation", test_instantiation);
   indicator_ng_test_add ("instantiation-with-profile", test_instantiation_with_profile);
+  indicator_ng_test_add ("instantiation-async", test_instantiation_async);
+  indicator_ng_test_add ("index", test_index);
   indicator_ng_test_add ("menu", test_menu);
+  indicator_ng_test_add ("menu-item-resize", test_menu_item_resize);
+  indicator_ng_test_add ("lazy-menu", test_lazy_menu);
+  indicator_ng_test_add ("prewarm-menu", test_prewarm_menu);
+  indicator_ng_test_add ("coalesce-updates", test_coalesce_updates);
+  indicator_ng_test_add ("max-update-rate", test_max_update_rate);
+  indicator_ng_test_add ("max-scrolls-in-flight", test_max_scrolls_in_flight);
+  indicator_ng_test_add ("shared-proxies", test_shared_proxies);
+  indicator_ng_test_add ("connection", test_connection);
+  indicator_ng_test_add ("headless", test_headless);
+  indicator_ng_test_add ("restart", test_restart);
+  indicator_ng_test_add ("shared-restart", test_shared_restart);
+  indicator_ng_test_add ("icon-cache", test_icon_cache);
+  indicator_ng_test_add ("stats", test_stats);
 
   return g_test_run ();
 }
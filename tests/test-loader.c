@@ -240,6 +240,302 @@ test_loader_filename_dummy_visible (void)
     gtk_widget_destroy(box);
 }
 
+static void
+foreach_entry_collect (IndicatorObject * io, IndicatorObjectEntry * entry, gpointer user_data)
+{
+    GList ** entries = user_data;
+
+    g_assert(entry->parent_object == io);
+    *entries = g_list_append (*entries, entry);
+}
+
+void
+test_loader_foreach_entry (void)
+{
+    IndicatorObject * object = indicator_object_new_from_file(BUILD_DIR "/libdummy-indicator-visible.so");
+    g_assert(object != NULL);
+
+    // the same entries as indicator_object_get_entries(), with their
+    // parent set the same way
+    GList * list = indicator_object_get_entries(object);
+    GList * foreach_list = NULL;
+    ((IndicatorObjectEntry *) list->data)->parent_object = NULL;
+    indicator_object_foreach_entry(object, foreach_entry_collect, &foreach_list);
+    g_assert(g_list_length(foreach_list) == 1);
+    g_assert(foreach_list->data == list->data);
+    g_list_free(foreach_list);
+    g_list_free(list);
+
+    // hidden entries are skipped
+    indicator_object_set_visible (object, FALSE);
+    foreach_list = NULL;
+    indicator_object_foreach_entry(object, foreach_entry_collect, &foreach_list);
+    g_assert(foreach_list == NULL);
+
+    indicator_object_set_visible (object, TRUE);
+    indicator_object_foreach_entry(object, foreach_entry_collect, &foreach_list);
+    g_assert(g_list_length(foreach_list) == 1);
+    g_list_free(foreach_list);
+
+    g_object_unref(object);
+}
+
+/* An indicator whose entries come and go */
+
+typedef struct { IndicatorObject parent; GList * entries; } ChurnIndicator;
+typedef struct { IndicatorObjectClass parent_class; } ChurnIndicatorClass;
+
+GType churn_indicator_get_type (void);
+G_DEFINE_TYPE (ChurnIndicator, churn_indicator, INDICATOR_OBJECT_TYPE);
+
+static GList *
+churn_indicator_get_entries (IndicatorObject * io)
+{
+    return g_list_copy (((ChurnIndicator *) io)->entries);
+}
+
+static void
+churn_indicator_finalize (GObject * object)
+{
+    g_list_free (((ChurnIndicator *) object)->entries);
+
+    G_OBJECT_CLASS (churn_indicator_parent_class)->finalize (object);
+}
+
+static void
+churn_indicator_class_init (ChurnIndicatorClass * klass)
+{
+    G_OBJECT_CLASS (klass)->finalize = churn_indicator_finalize;
+    INDICATOR_OBJECT_CLASS (klass)->get_entries = churn_indicator_get_entries;
+}
+
+static void
+churn_indicator_init (ChurnIndicator * self)
+{
+}
+
+static guint
+get_entry_states (IndicatorObject * io)
+{
+    GVariant * stats = indicator_object_get_stats (io);
+    guint32 states = 0;
+
+    g_assert(g_variant_lookup (stats, "entry-states", "u", &states));
+    g_variant_unref (stats);
+
+    return states;
+}
+
+void
+test_loader_entry_churn (void)
+{
+    ChurnIndicator * churn = g_object_new (churn_indicator_get_type (), NULL);
+    IndicatorObject * object = INDICATOR_OBJECT (churn);
+    IndicatorObjectEntry * persistent = g_new0 (IndicatorObjectEntry, 1);
+    GPtrArray * gone = g_ptr_array_new_with_free_func (g_free);
+    guint i, peak = 0;
+
+    churn->entries = g_list_append (churn->entries, persistent);
+    g_signal_emit_by_name (object, INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED, persistent);
+    indicator_object_set_visible (object, FALSE);
+
+    // entries that come and go must not leave their state behind,
+    // they are kept allocated so that no address gets reused
+    for (i = 0; i < 1000; i++) {
+        IndicatorObjectEntry * entry = g_new0 (IndicatorObjectEntry, 1);
+
+        churn->entries = g_list_append (churn->entries, entry);
+        g_signal_emit_by_name (object, INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED, entry);
+        churn->entries = g_list_remove (churn->entries, entry);
+        g_signal_emit_by_name (object, INDICATOR_OBJECT_SIGNAL_ENTRY_REMOVED, entry);
+        g_ptr_array_add (gone, entry);
+
+        peak = MAX (peak, get_entry_states (object));
+    }
+
+    g_assert_cmpuint (peak, <=, 16);
+
+    // while the state of the remaining entry is kept
+    g_assert(!indicator_object_entry_is_visible (object, persistent));
+    GList * list = indicator_object_get_entries (object);
+    g_assert(list == NULL);
+
+    g_object_unref (object);
+    g_ptr_array_unref (gone);
+    g_free (persistent);
+}
+
+typedef struct { guint emissions; guint added; guint removed; } EntriesChanged;
+
+static void
+entries_changed_cb (IndicatorObject * io, GPtrArray * added, GPtrArray * removed, gpointer user_data)
+{
+    EntriesChanged * changed = user_data;
+    guint i;
+
+    // the entries are fully added or removed by the time of the signal
+    for (i = 0; i < added->len; i++) {
+        IndicatorObjectEntry * entry = g_ptr_array_index (added, i);
+        g_assert (entry->parent_object == io);
+    }
+    for (i = 0; i < removed->len; i++) {
+        IndicatorObjectEntry * entry = g_ptr_array_index (removed, i);
+        g_assert (entry->parent_object == NULL);
+    }
+
+    changed->emissions++;
+    changed->added = added->len;
+    changed->removed = removed->len;
+}
+
+void
+test_loader_entries_changed (void)
+{
+    ChurnIndicator * churn = g_object_new (churn_indicator_get_type (), NULL);
+    IndicatorObject * object = INDICATOR_OBJECT (churn);
+    IndicatorObjectEntry entries[3] = { { 0 } };
+    EntriesChanged changed = { 0, 0, 0 };
+    guint i;
+
+    g_signal_connect (object, INDICATOR_OBJECT_SIGNAL_ENTRIES_CHANGED,
+                      G_CALLBACK (entries_changed_cb), &changed);
+
+    // unfrozen, every entry is a batch of its own
+    churn->entries = g_list_append (churn->entries, &entries[0]);
+    g_signal_emit_by_name (object, INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED, &entries[0]);
+    g_assert_cmpuint (changed.emissions, ==, 1);
+    g_assert_cmpuint (changed.added, ==, 1);
+
+    // frozen, the entries are batched and an entry that came and went
+    // isn't reported at all
+    indicator_object_freeze_entries (object);
+    for (i = 1; i < 3; i++) {
+        churn->entries = g_list_append (churn->entries, &entries[i]);
+        g_signal_emit_by_name (object, INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED, &entries[i]);
+    }
+    churn->entries = g_list_remove (churn->entries, &entries[2]);
+    g_signal_emit_by_name (object, INDICATOR_OBJECT_SIGNAL_ENTRY_REMOVED, &entries[2]);
+    g_assert_cmpuint (changed.emissions, ==, 1);
+    indicator_object_thaw_entries (object);
+    g_assert_cmpuint (changed.emissions, ==, 2);
+    g_assert_cmpuint (changed.added, ==, 1);
+    g_assert_cmpuint (changed.removed, ==, 0);
+
+    // hiding all entries is a single batch
+    indicator_object_set_visible (object, FALSE);
+    g_assert_cmpuint (changed.emissions, ==, 3);
+    g_assert_cmpuint (changed.added, ==, 0);
+    g_assert_cmpuint (changed.removed, ==, 2);
+
+    g_object_unref (object);
+}
+
+static void
+new_from_files_ready (GObject * source_object, GAsyncResult * result, gpointer user_data)
+{
+    GList ** objects = user_data;
+    GError * error = NULL;
+
+    *objects = indicator_object_new_from_files_finish (result, &error);
+    g_assert_no_error (error);
+    g_assert (*objects != NULL);
+}
+
+void
+test_loader_new_from_files_async (void)
+{
+    const gchar * files[] = {
+        BUILD_DIR "/libdummy-indicator-simple.so",
+        BUILD_DIR "/this-file-does-not-exist.so",
+        BUILD_DIR "/libdummy-indicator-visible.so",
+        NULL
+    };
+    GList * objects = NULL;
+
+    indicator_object_new_from_files_async (files, NULL, new_from_files_ready, &objects);
+    while (objects == NULL)
+        g_main_context_iteration(NULL, TRUE);
+
+    // the missing module is skipped, the others keep their order
+    g_assert(g_list_length(objects) == 2);
+    g_assert_cmpstr(G_OBJECT_TYPE_NAME(objects->data), ==, "DummyIndicatorSimple");
+    g_assert_cmpstr(G_OBJECT_TYPE_NAME(objects->next->data), ==, "DummyIndicatorVisible");
+
+    GList * entries = indicator_object_get_entries(objects->data);
+    g_assert(g_list_length(entries) == 1);
+    g_list_free(entries);
+
+    g_list_free_full(objects, g_object_unref);
+}
+
+static guint
+get_module_stat (const gchar * key)
+{
+    GVariant * stats = indicator_object_get_module_stats ();
+    guint32 value = 0;
+
+    g_assert(g_variant_lookup (stats, key, "u", &value));
+    g_variant_unref (stats);
+
+    return value;
+}
+
+static void
+release_modules (void)
+{
+    // modules are released from an idle after the object is gone
+    while (g_main_context_pending(NULL))
+        g_main_context_iteration(NULL, TRUE);
+}
+
+void
+test_loader_module_registry (void)
+{
+    indicator_object_set_module_keep_warm (60);
+
+    // the same module, reached through two paths
+    IndicatorObject * object = indicator_object_new_from_file(BUILD_DIR "/libdummy-indicator-simple.so");
+    g_assert(object != NULL);
+    guint hits = get_module_stat("module-registry-hits");
+    IndicatorObject * other = indicator_object_new_from_file(BUILD_DIR "/./libdummy-indicator-simple.so");
+    g_assert(other != NULL);
+    g_assert_cmpuint(get_module_stat("module-registry-hits"), ==, hits + 1);
+    g_assert(G_OBJECT_TYPE(object) == G_OBJECT_TYPE(other));
+    GType type = G_OBJECT_TYPE(object);
+
+    g_object_unref(object);
+    g_object_unref(other);
+    release_modules();
+
+    // kept warm after the last object is gone
+    object = indicator_object_new_from_file(BUILD_DIR "/libdummy-indicator-simple.so");
+    g_assert(object != NULL);
+    g_assert(G_OBJECT_TYPE(object) == type);
+    g_assert_cmpuint(get_module_stat("module-registry-hits"), ==, hits + 2);
+
+    // which is process-wide, not counted in every object's stats
+    GVariant * stats = indicator_object_get_stats(object);
+    g_assert(!g_variant_lookup(stats, "module-registry-hits", "u", NULL));
+    g_variant_unref(stats);
+
+    GList * entries = indicator_object_get_entries(object);
+    g_assert(g_list_length(entries) == 1);
+    g_list_free(entries);
+
+    g_object_unref(object);
+    release_modules();
+
+    // turning keep-warm off closes it instead of leaving the timeout behind
+    guint modules = get_module_stat("modules");
+    indicator_object_set_module_keep_warm (0);
+    g_assert_cmpuint(get_module_stat("modules"), ==, modules - 1);
+    object = indicator_object_new_from_file(BUILD_DIR "/libdummy-indicator-simple.so");
+    g_assert(object != NULL);
+    g_assert_cmpuint(get_module_stat("module-registry-hits"), ==, hits + 2);
+    g_object_unref(object);
+    release_modules();
+}
+
 /***
 ****
 ***/
@@ -310,6 +606,26 @@ test_loader_filename_dummy_null (void)
     g_object_unref(G_OBJECT(object));
     return;
 }
+void
+test_loader_foreach_entry_null (void)
+{
+    ChurnIndicator * churn = g_object_new (churn_indicator_get_type (), NULL);
+    IndicatorObject * object = INDICATOR_OBJECT (churn);
+    IndicatorObjectEntry * entry = g_new0 (IndicatorObjectEntry, 1);
+
+    // NULL list elements aren't entries, they are skipped
+    churn->entries = g_list_append (churn->entries, NULL);
+    churn->entries = g_list_append (churn->entries, entry);
+
+    GList * foreach_list = NULL;
+    indicator_object_foreach_entry(object, foreach_entry_collect, &foreach_list);
+    g_assert(g_list_length(foreach_list) == 1);
+    g_assert(foreach_list->data == entry);
+    g_list_free(foreach_list);
+
+    g_object_unref (object);
+    g_free (entry);
+}
 
 void
 test_loader_filename_bad (void)
@@ -356,6 +672,12 @@ test_loader_creation_deletion_suite (void)
     g_test_add_func ("/libindicator/loader/dummy/entry_funcs",  test_loader_entry_funcs);
     g_test_add_func ("/libindicator/loader/dummy/entry_func_window",  test_loader_entry_func_window);
     g_test_add_func ("/libindicator/loader/dummy/visible",  test_loader_filename_dummy_visible);
+    g_test_add_func ("/libindicator/loader/dummy/foreach_entry",  test_loader_foreach_entry);
+    g_test_add_func ("/libindicator/loader/foreach_entry_null",  test_loader_foreach_entry_null);
+    g_test_add_func ("/libindicator/loader/entry_churn",  test_loader_entry_churn);
+    g_test_add_func ("/libindicator/loader/entries_changed",  test_loader_entries_changed);
+    g_test_add_func ("/libindicator/loader/new_from_files_async",  test_loader_new_from_files_async);
+    g_test_add_func ("/libindicator/loader/module_registry",  test_loader_module_registry);
 
     return;
 }
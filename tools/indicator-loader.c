@@ -57,6 +57,21 @@ activate_entry (GtkWidget * widget, gpointer user_data)
     }
 }
 
+static gboolean
+enter_entry (GtkWidget * widget, __attribute__((unused)) GdkEventCrossing * event, gpointer user_data)
+{
+  gpointer entry;
+
+  g_return_val_if_fail (INDICATOR_IS_OBJECT(user_data), FALSE);
+
+  entry = g_object_get_qdata (G_OBJECT(widget), entry_data_quark());
+
+  if (entry != NULL)
+    indicator_object_entry_pointer_enter (INDICATOR_OBJECT(user_data), entry);
+
+  return FALSE;
+}
+
 static void
 scroll_entry (GtkWidget *widget, GdkEventScroll* event, gpointer user_data)
 {
@@ -151,6 +166,7 @@ entry_added (IndicatorObject      * io,
 
       g_object_set_qdata (G_OBJECT(menu_item), entry_data_quark(), entry);
       g_signal_connect (menu_item, "activate", G_CALLBACK(activate_entry), io);
+      g_signal_connect (menu_item, "enter-notify-event", G_CALLBACK(enter_entry), io);
 
       gtk_widget_set_events (menu_item, gtk_widget_get_events (menu_item) | GDK_SCROLL_MASK);
       g_signal_connect (menu_item, "scroll-event", G_CALLBACK(scroll_entry), io);